@@ -8,6 +8,11 @@
 Config systemConfig;
 
 bool loadConfig(const std::string& filename) {
+    return loadConfig(filename, systemConfig);
+}
+
+// Reads filename into config. Keys missing from the file keep their current values in config.
+bool loadConfig(const std::string& filename, Config& config) {
     std::ifstream file(filename);
     if (!file.is_open()) {
         std::cerr << "Failed to open " << filename << "\n";
@@ -17,21 +22,75 @@ bool loadConfig(const std::string& filename) {
     std::string key;
     while (file >> key) {
         if (key == "num-cpu") {
-            file >> systemConfig.numCPU;
+            file >> config.numCPU;
         } else if (key == "scheduler") {
             std::string sched;
             file >> std::quoted(sched);  // Reads quoted string 
-            systemConfig.scheduler = sched;
+            config.scheduler = sched;
         } else if (key == "quantum-cycles") {
-            file >> systemConfig.quantumCycles;
+            file >> config.quantumCycles;
         } else if (key == "batch-process-freq") {
-            file >> systemConfig.batchProcessFreq;
+            file >> config.batchProcessFreq;
         } else if (key == "min-ins") {
-            file >> systemConfig.minInstructions;
+            file >> config.minInstructions;
         } else if (key == "max-ins") {
-            file >> systemConfig.maxInstructions;
+            file >> config.maxInstructions;
         } else if (key == "delay-per-exec") {
-            file >> systemConfig.delayPerExec;
+            file >> config.delayPerExec;
+        } else if (key == "instructions-per-tick") {
+            file >> config.instructionsPerTick;
+        } else if (key == "optimize-programs") {
+            file >> config.optimizePrograms;
+        } else if (key == "cache-affinity") {
+            file >> config.cacheAffinity;
+        } else if (key == "migration-cost") {
+            file >> config.migrationCost;
+        } else if (key == "context-switch-cycles") {
+            file >> config.contextSwitchCycles;
+        } else if (key == "quantum-autotune") {
+            file >> config.quantumAutotune;
+        } else if (key == "autotune-target") {
+            file >> config.autotuneTarget;
+        } else if (key == "autotune-interval") {
+            file >> config.autotuneInterval;
+        } else if (key == "autotune-max-wait") {
+            file >> config.autotuneMaxWait;
+        } else if (key == "max-overall-mem") {
+            file >> config.maxOverallMem;
+        } else if (key == "min-mem-per-proc") {
+            file >> config.minMemPerProc;
+        } else if (key == "max-mem-per-proc") {
+            file >> config.maxMemPerProc;
+        } else if (key == "mem-allocator") {
+            std::string allocator;
+            file >> std::quoted(allocator);
+            config.memAllocator = allocator;
+        } else if (key == "swap-threshold-ms") {
+            file >> config.swapThresholdMs;
+        } else if (key == "swap-file") {
+            std::string path;
+            file >> std::quoted(path);
+            config.swapFile = path;
+        } else if (key == "domains") {
+            file >> config.domains;
+        } else if (key == "stats-socket") {
+            std::string path;
+            file >> std::quoted(path);
+            config.statsSocket = path;
+        } else if (key == "log-interval-ms") {
+            file >> config.logIntervalMs;
+        } else if (key == "log-file") {
+            std::string path;
+            file >> std::quoted(path);
+            config.logFile = path;
+        } else if (key == "log-max-bytes") {
+            file >> config.logMaxBytes;
+        } else if (key == "log-max-age-s") {
+            file >> config.logMaxAgeS;
+        } else if (key == "tickets") {
+            std::string rules;
+            file >> std::quoted(rules);
+            config.tickets = rules;
         } else {
             std::cerr << "Unknown config key: " << key << "\n";
         }
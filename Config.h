@@ -11,10 +11,33 @@ struct Config {
     int minInstructions;
     int maxInstructions;
     int delayPerExec;
+    int instructionsPerTick; // burst length each core runs per scheduler tick
+    int optimizePrograms;    // 1 = fuse arithmetic and fold loops at program load
+    int cacheAffinity;  // 1 = prefer dispatching a process on the core it last ran on
+    int migrationCost;  // warm-up cycles charged when a process resumes on another core
+    int contextSwitchCycles; // overhead cycles charged on every dispatch
+    int quantumAutotune;     // 1 = adjust quantum-cycles at runtime
+    double autotuneTarget;   // target context-switch overhead as a fraction of busy cycles
+    int autotuneInterval;    // ticks between auto-tuner decisions
+    double autotuneMaxWait;  // mean ready-queue wait in ticks the tuner keeps under; 0 = no bound
+    long long maxOverallMem; // simulated physical memory in bytes; 0 = no memory simulation
+    int minMemPerProc;       // bytes a process needs, drawn from [min, max] at creation
+    int maxMemPerProc;
+    std::string memAllocator; // "first-fit", "best-fit" or "buddy"
+    int swapThresholdMs;      // idle ms before a ready or finished process is swapped out; 0 = no swapping
+    std::string swapFile;     // where swapped-out process images are kept
+    int domains;              // scheduler domains the cores are partitioned into
+    std::string statsSocket;  // Unix socket serving live stats; empty = no stats server
+    int logIntervalMs;        // ms between utilization log samples; 0 = no log
+    std::string logFile;      // active utilization log; rotated segments get .1, .2, ...
+    long long logMaxBytes;    // rotate once the active log reaches this size; 0 = never
+    int logMaxAgeS;           // rotate once the active log spans this many seconds; 0 = never
+    std::string tickets;      // stride/lottery ticket rules, "prefix*=N name=N ..."; first match wins
 };
 
 extern Config systemConfig;
 
 bool loadConfig(const std::string& filename);
+bool loadConfig(const std::string& filename, Config& config);
 
 #endif
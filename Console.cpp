@@ -0,0 +1,106 @@
+#include "Console.h"
+#include <iostream>
+
+Console console;
+
+namespace {
+
+// std::cout's buffer once installed: collects text per thread and hands it to the
+// console as a block on flush (std::flush, std::endl, or input from std::cin)
+class ConsoleBuffer : public std::streambuf {
+protected:
+    int_type overflow(int_type c) override {
+        if (!traits_type::eq_int_type(c, traits_type::eof())) {
+            pending() += traits_type::to_char_type(c);
+        }
+        return traits_type::not_eof(c);
+    }
+
+    std::streamsize xsputn(const char* text, std::streamsize count) override {
+        pending().append(text, (size_t)count);
+        return count;
+    }
+
+    int sync() override {
+        std::string& text = pending();
+        if (!text.empty()) {
+            console.write(text);
+            text.clear();
+        }
+        return 0;
+    }
+
+private:
+    static std::string& pending() {
+        thread_local std::string buffer;
+        return buffer;
+    }
+};
+
+ConsoleBuffer consoleBuffer;
+
+const char kPrompt[] = ">";
+
+}
+
+void Console::install() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!terminal) {
+        terminal = std::cout.rdbuf(&consoleBuffer);
+    }
+}
+
+void Console::write(const std::string& text) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (owner != std::thread::id() && owner != std::this_thread::get_id()) {
+        held += text;
+        return;
+    }
+    emit(text);
+}
+
+void Console::notice(const std::string& text) {
+    write("\n" + text + "\n");
+}
+
+void Console::showPrompt() {
+    if (headlessMode) return;
+    std::lock_guard<std::mutex> lock(mutex);
+    emit(std::string("\n") + kPrompt);
+    promptShown = true;
+}
+
+void Console::promptAnswered() {
+    std::lock_guard<std::mutex> lock(mutex);
+    promptShown = false;
+}
+
+void Console::acquire() {
+    std::lock_guard<std::mutex> lock(mutex);
+    owner = std::this_thread::get_id();
+}
+
+void Console::release() {
+    std::lock_guard<std::mutex> lock(mutex);
+    owner = std::thread::id();
+    if (!held.empty()) {
+        emit(held);
+        held.clear();
+    }
+}
+
+// Caller holds mutex
+void Console::emit(const std::string& text) {
+    std::streambuf* out = terminal ? terminal : std::cout.rdbuf();
+    if (promptShown) {
+        // Move off the prompt line, print the block, then put the prompt back
+        std::string block = text;
+        if (block.empty() || block.front() != '\n') block.insert(block.begin(), '\n');
+        if (block.back() != '\n') block += '\n';
+        block += kPrompt;
+        out->sputn(block.data(), (std::streamsize)block.size());
+    } else {
+        out->sputn(text.data(), (std::streamsize)text.size());
+    }
+    out->pubsync();
+}
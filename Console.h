@@ -0,0 +1,53 @@
+#ifndef CONSOLE_H
+#define CONSOLE_H
+
+#include <string>
+#include <mutex>
+#include <thread>
+#include <streambuf>
+#include <iostream>
+
+// The one channel to the terminal. install() routes std::cout through it: each thread's
+// output is buffered separately and reaches the terminal as one block when that thread
+// flushes, so the command executor, the CLI and the scheduler threads never interleave
+// mid-line. A block arriving while the prompt is up is printed above a redrawn prompt,
+// and while a screen session owns the terminal other threads' output is held back.
+//
+// In headless mode (--script, or stdin not a terminal) there is no prompt and no ANSI
+// screen control, so the output is a plain transcript that can be captured.
+class Console {
+public:
+    void install();
+    void setHeadless(bool enabled) { headlessMode = enabled; }
+    bool headless() const { return headlessMode; }
+    // Where commands (and screen session input) are read from; std::cin by default
+    void setInput(std::istream& stream) { in = &stream; }
+    std::istream& input() { return *in; }
+
+    void write(const std::string& text);
+    // Background message (scheduler, replay) printed on lines of its own
+    void notice(const std::string& text);
+
+    void showPrompt();
+    void promptAnswered();
+
+    // The calling thread takes the terminal for itself until release(), which then
+    // prints whatever was held back
+    void acquire();
+    void release();
+
+private:
+    void emit(const std::string& text);
+
+    std::mutex mutex;
+    std::streambuf* terminal = nullptr;
+    bool promptShown = false;
+    bool headlessMode = false;
+    std::istream* in = &std::cin;
+    std::thread::id owner;
+    std::string held;
+};
+
+extern Console console;
+
+#endif
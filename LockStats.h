@@ -0,0 +1,73 @@
+#ifndef LOCK_STATS_H
+#define LOCK_STATS_H
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <shared_mutex>
+
+// Acquisition count plus total wait and hold time for one lock (and one mode, for
+// reader-writer locks). Counters are relaxed atomics so 'lock-stats' can read them
+// without taking the lock being measured.
+struct LockStats {
+    const char* name;
+    std::atomic<long long> acquisitions;
+    std::atomic<long long> waitNs;
+    std::atomic<long long> holdNs;
+    std::atomic<long long> maxHoldNs;
+
+    explicit LockStats(const char* lockName) : name(lockName), acquisitions(0), waitNs(0), holdNs(0), maxHoldNs(0) {}
+
+    void record(long long wait, long long hold) {
+        acquisitions.fetch_add(1, std::memory_order_relaxed);
+        waitNs.fetch_add(wait, std::memory_order_relaxed);
+        holdNs.fetch_add(hold, std::memory_order_relaxed);
+        long long longest = maxHoldNs.load(std::memory_order_relaxed);
+        while (hold > longest && !maxHoldNs.compare_exchange_weak(longest, hold, std::memory_order_relaxed)) {
+        }
+    }
+
+    void reset() {
+        acquisitions = 0;
+        waitNs = 0;
+        holdNs = 0;
+        maxHoldNs = 0;
+    }
+};
+
+// Scoped lock that records into a LockStats how long it waited for the mutex and how
+// long it then held it. Lock is std::unique_lock or std::shared_lock.
+template <typename Lock>
+class TimedLock {
+public:
+    template <typename Mutex>
+    TimedLock(Mutex& mutex, LockStats& stats)
+        : stats(stats), requested(std::chrono::steady_clock::now()), lock(mutex),
+          acquired(std::chrono::steady_clock::now()) {}
+
+    ~TimedLock() {
+        if (lock.owns_lock()) unlock();
+    }
+
+    TimedLock(const TimedLock&) = delete;
+    TimedLock& operator=(const TimedLock&) = delete;
+
+    void unlock() {
+        auto released = std::chrono::steady_clock::now();
+        lock.unlock();
+        stats.record(std::chrono::duration_cast<std::chrono::nanoseconds>(acquired - requested).count(),
+                     std::chrono::duration_cast<std::chrono::nanoseconds>(released - acquired).count());
+    }
+
+private:
+    LockStats& stats;
+    std::chrono::steady_clock::time_point requested;
+    Lock lock;
+    std::chrono::steady_clock::time_point acquired;
+};
+
+template <typename Mutex>
+using TimedUniqueLock = TimedLock<std::unique_lock<Mutex>>;
+using TimedSharedLock = TimedLock<std::shared_lock<std::shared_mutex>>;
+
+#endif
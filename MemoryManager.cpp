@@ -0,0 +1,205 @@
+#include "MemoryManager.h"
+#include <chrono>
+#include <algorithm>
+
+// FitAllocator implementation
+FitAllocator::FitAllocator(long long total, bool bestFit) : total(total), bestFit(bestFit), freeTotal(total) {
+    holes[0] = total;
+}
+
+long long FitAllocator::allocate(long long size) {
+    auto chosen = holes.end();
+    for (auto it = holes.begin(); it != holes.end(); ++it) {
+        if (it->second < size) continue;
+        if (!bestFit) {
+            chosen = it;
+            break;
+        }
+        if (chosen == holes.end() || it->second < chosen->second) {
+            chosen = it;
+        }
+    }
+    if (chosen == holes.end()) return -1;
+
+    long long address = chosen->first;
+    long long remaining = chosen->second - size;
+    holes.erase(chosen);
+    if (remaining > 0) {
+        holes[address + size] = remaining;
+    }
+    regions[address] = size;
+    freeTotal -= size;
+    return address;
+}
+
+void FitAllocator::release(long long address) {
+    auto region = regions.find(address);
+    if (region == regions.end()) return;
+    long long size = region->second;
+    regions.erase(region);
+    freeTotal += size;
+
+    // Coalesce with the holes on either side
+    auto next = holes.lower_bound(address);
+    if (next != holes.end() && address + size == next->first) {
+        size += next->second;
+        next = holes.erase(next);
+    }
+    if (next != holes.begin()) {
+        auto prev = std::prev(next);
+        if (prev->first + prev->second == address) {
+            prev->second += size;
+            return;
+        }
+    }
+    holes[address] = size;
+}
+
+long long FitAllocator::largestFreeBlock() const {
+    long long largest = 0;
+    for (const auto& hole : holes) {
+        largest = std::max(largest, hole.second);
+    }
+    return largest;
+}
+
+// BuddyAllocator implementation
+BuddyAllocator::BuddyAllocator(long long total) : maxOrder(kMinOrder), freeTotal(0), waste(0) {
+    while ((1LL << (maxOrder + 1)) <= total) {
+        maxOrder++;
+    }
+    freeLists.resize(maxOrder + 1);
+    if (total >= (1LL << kMinOrder)) {
+        freeLists[maxOrder].insert(0);
+        freeTotal = 1LL << maxOrder;
+    }
+}
+
+long long BuddyAllocator::allocate(long long size) {
+    int order = kMinOrder;
+    while (order <= maxOrder && (1LL << order) < size) {
+        order++;
+    }
+    int k = order;
+    while (k <= maxOrder && freeLists[k].empty()) {
+        k++;
+    }
+    if (k > maxOrder) return -1;
+
+    long long address = *freeLists[k].begin();
+    freeLists[k].erase(freeLists[k].begin());
+    while (k > order) {
+        k--;
+        freeLists[k].insert(address + (1LL << k)); // upper half becomes a free buddy
+    }
+
+    blocks[address] = Block{order, size};
+    freeTotal -= 1LL << order;
+    waste += (1LL << order) - size;
+    return address;
+}
+
+void BuddyAllocator::release(long long address) {
+    auto block = blocks.find(address);
+    if (block == blocks.end()) return;
+    int order = block->second.order;
+    freeTotal += 1LL << order;
+    waste -= (1LL << order) - block->second.requested;
+    blocks.erase(block);
+
+    while (order < maxOrder) {
+        long long buddy = address ^ (1LL << order);
+        if (!freeLists[order].erase(buddy)) break;
+        address = std::min(address, buddy);
+        order++;
+    }
+    freeLists[order].insert(address);
+}
+
+long long BuddyAllocator::largestFreeBlock() const {
+    for (int order = maxOrder; order >= kMinOrder; order--) {
+        if (!freeLists[order].empty()) return 1LL << order;
+    }
+    return 0;
+}
+
+// MemoryManager implementation
+bool MemoryManager::configure(const std::string& strategy, long long totalBytes) {
+    std::unique_ptr<MemoryAllocator> created;
+    if (totalBytes > 0) {
+        if (strategy == "first-fit") {
+            created.reset(new FitAllocator(totalBytes, false));
+        } else if (strategy == "best-fit") {
+            created.reset(new FitAllocator(totalBytes, true));
+        } else if (strategy == "buddy") {
+            created.reset(new BuddyAllocator(totalBytes));
+        } else {
+            return false;
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    allocator = std::move(created);
+    counters = MemoryStats();
+    counters.strategy = strategy;
+    return true;
+}
+
+bool MemoryManager::enabled() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return allocator != nullptr;
+}
+
+long long MemoryManager::total() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return allocator ? allocator->capacity() : 0;
+}
+
+long long MemoryManager::allocate(long long size) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!allocator) return -1;
+
+    auto start = std::chrono::steady_clock::now();
+    long long address = allocator->allocate(size);
+    long long ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+
+    counters.allocationNs += ns;
+    counters.maxAllocationNs = std::max(counters.maxAllocationNs, ns);
+    if (address < 0) {
+        counters.failedAllocations++;
+    } else {
+        counters.allocations++;
+        counters.resident++;
+    }
+    return address;
+}
+
+void MemoryManager::release(long long address) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!allocator || address < 0) return;
+    allocator->release(address);
+    counters.resident--;
+}
+
+void MemoryManager::recordEviction() {
+    std::lock_guard<std::mutex> lock(mutex);
+    counters.evictions++;
+}
+
+void MemoryManager::recordDeferral() {
+    std::lock_guard<std::mutex> lock(mutex);
+    counters.deferrals++;
+}
+
+MemoryStats MemoryManager::stats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    MemoryStats stats = counters;
+    if (allocator) {
+        stats.total = allocator->capacity();
+        stats.free = allocator->freeBytes();
+        stats.used = stats.total - stats.free;
+        stats.largestFree = allocator->largestFreeBlock();
+        stats.internalWaste = allocator->internalWaste();
+    }
+    return stats;
+}
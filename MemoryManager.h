@@ -0,0 +1,112 @@
+#ifndef MEMORY_MANAGER_H
+#define MEMORY_MANAGER_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <mutex>
+#include <memory>
+
+// Placement strategy over a simulated physical address space [0, total)
+class MemoryAllocator {
+public:
+    virtual ~MemoryAllocator() = default;
+    // Returns the address of a region of at least size bytes, or -1 if none is free
+    virtual long long allocate(long long size) = 0;
+    virtual void release(long long address) = 0;
+    virtual long long capacity() const = 0;
+    virtual long long freeBytes() const = 0;
+    virtual long long largestFreeBlock() const = 0;
+    // Bytes handed out beyond what was asked for (buddy rounding)
+    virtual long long internalWaste() const = 0;
+};
+
+// First-fit and best-fit over a sorted list of holes, coalescing on release
+class FitAllocator : public MemoryAllocator {
+public:
+    FitAllocator(long long total, bool bestFit);
+    long long allocate(long long size) override;
+    void release(long long address) override;
+    long long capacity() const override { return total; }
+    long long freeBytes() const override { return freeTotal; }
+    long long largestFreeBlock() const override;
+    long long internalWaste() const override { return 0; }
+
+private:
+    long long total;
+    bool bestFit;
+    long long freeTotal;
+    std::map<long long, long long> holes;     // address -> size
+    std::map<long long, long long> regions;   // address -> size
+};
+
+// Binary buddy system: power-of-two blocks split on demand and merged with their
+// buddy on release
+class BuddyAllocator : public MemoryAllocator {
+public:
+    explicit BuddyAllocator(long long total);
+    long long allocate(long long size) override;
+    void release(long long address) override;
+    long long capacity() const override { return 1LL << maxOrder; }
+    long long freeBytes() const override { return freeTotal; }
+    long long largestFreeBlock() const override;
+    long long internalWaste() const override { return waste; }
+
+    static const int kMinOrder = 4; // 16-byte blocks
+
+private:
+    int maxOrder;
+    long long freeTotal;
+    long long waste;
+    std::vector<std::set<long long>> freeLists; // by order
+    struct Block { int order; long long requested; };
+    std::map<long long, Block> blocks;          // allocated, by address
+};
+
+struct MemoryStats {
+    std::string strategy;
+    long long total = 0;
+    long long used = 0;
+    long long free = 0;
+    long long largestFree = 0;
+    long long internalWaste = 0;
+    int resident = 0;
+    long long allocations = 0;
+    long long failedAllocations = 0;
+    long long allocationNs = 0;
+    long long maxAllocationNs = 0;
+    long long evictions = 0;
+    long long deferrals = 0;
+
+    // 1 - largest free block / free memory: how much of the free memory a single
+    // request cannot use
+    double externalFragmentation() const {
+        return free > 0 ? 1.0 - (double)largestFree / free : 0.0;
+    }
+};
+
+// The simulated physical memory processes are placed in. Thread-safe; the scheduling
+// loop allocates and releases while vmstat reads the statistics.
+class MemoryManager {
+public:
+    // Starts over with an empty address space of totalBytes using strategy
+    // ("first-fit", "best-fit" or "buddy"). totalBytes 0 turns the simulation off.
+    bool configure(const std::string& strategy, long long totalBytes);
+    bool enabled() const;
+    long long total() const;
+
+    long long allocate(long long size);
+    void release(long long address);
+    void recordEviction();
+    void recordDeferral();
+
+    MemoryStats stats() const;
+
+private:
+    mutable std::mutex mutex;
+    std::unique_ptr<MemoryAllocator> allocator;
+    MemoryStats counters;
+};
+
+#endif
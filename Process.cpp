@@ -1,20 +1,102 @@
 #include "Process.h"
+#include "Serialize.h"
+#include "Program.h"
 #include <random>
+#include <algorithm>
 
 // Instruction implementation
 Instruction::Instruction(InstructionType t, const std::string& m, const std::string& var, int val) 
-    : type(t), msg(m), varName(var), value(val), forIterations(0), executedAt(std::nullopt) {}
+    : type(t), msg(m), varName(var), value(val), jumpTarget(-1), loopSlot(-1), varSlot(-1), weight(1), line(-1), fileLine(0) {}
 
 // Process implementation
 Process::Process(const std::string& processName, int processId) 
-    : name(processName), id(processId), state(ProcessState::READY), 
-      currentInstruction(0), coreId(-1), isFinished(false) {
+    : name(processName), id(processId), table(nullptr), 
+      lineCount(0), migrations(0), weightPaid(0), memorySize(0), memoryAddress(-1), swapOffset(-1), pins(0), idleEpoch(0), readyTick(0),
+      nice(0), vruntime(0), tickets(0), ticksRun(0), shareClass(0), deadlineMs(0) {
     creationTime = std::chrono::system_clock::now();
 }
 
+// PrintLog implementation
+void PrintLog::append(const std::vector<PrintRecord>& newRecords) {
+    std::lock_guard<std::mutex> lock(mutex);
+    records.insert(records.end(), newRecords.begin(), newRecords.end());
+}
+
+size_t PrintLog::size() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return records.size();
+}
+
+std::vector<PrintRecord> PrintLog::read(size_t first, size_t count) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    first = std::min(first, records.size());
+    count = std::min(count, records.size() - first);
+    return std::vector<PrintRecord>(records.begin() + first, records.begin() + first + count);
+}
+
+void PrintLog::clear() {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<PrintRecord>().swap(records);
+}
+
+// ProcessTable implementation
+ProcessTable::ProcessTable() : chunks(new std::unique_ptr<Chunk>[kMaxChunks]) {}
+
+Process* ProcessTable::add(std::unique_ptr<Process> process) {
+    int pid = (int)processes.size();
+    if (pid >= kMaxChunks * kChunkSize || (process->id != -1 && process->id != pid)) {
+        return nullptr;
+    }
+    if (!chunks[pid >> kChunkShift]) {
+        chunks[pid >> kChunkShift].reset(new Chunk());
+    }
+
+    process->id = pid;
+    process->table = this;
+    process->state() = ProcessState::READY;
+    process->finished() = 0;
+    process->coreId() = -1;
+    process->currentInstruction() = 0;
+    processes.push_back(std::move(process));
+    return processes.back().get();
+}
+
+void ProcessTable::clear() {
+    processes.clear();
+    for (int i = 0; i < kMaxChunks && chunks[i]; i++) {
+        chunks[i].reset();
+    }
+}
+
+void ProcessTable::takeFrom(ProcessTable& other) {
+    clear();
+    std::swap(chunks, other.chunks);
+    processes.swap(other.processes);
+    for (auto& process : processes) {
+        process->table = this;
+    }
+}
+
+size_t ProcessTable::countFinished() const {
+    size_t count = 0;
+    for (size_t base = 0; base < processes.size(); base += kChunkSize) {
+        const Chunk& c = *chunks[base >> kChunkShift];
+        size_t n = std::min<size_t>(kChunkSize, processes.size() - base);
+        for (size_t i = 0; i < n; i++) {
+            count += c.finished[i];
+        }
+    }
+    return count;
+}
+
 void Process::generateRandomInstructions(int minIns, int maxIns) {
     std::random_device rd;
-    std::mt19937 gen(rd());
+    generateRandomInstructions(minIns, maxIns, rd());
+}
+
+// Same program for the same seed, so workload traces can be replayed exactly
+void Process::generateRandomInstructions(int minIns, int maxIns, unsigned int seed) {
+    std::mt19937 gen(seed);
     std::uniform_int_distribution<> instructionDist(minIns, maxIns);
     std::uniform_int_distribution<> typeDist(0, 5);
     std::uniform_int_distribution<> valueDist(1, 100);
@@ -58,4 +140,241 @@ void Process::generateRandomInstructions(int minIns, int maxIns) {
                 break;
         }
     }
+
+    // Generated loops are always balanced, so building cannot fail
+    ProgramLayout layout;
+    std::string error;
+    buildProgram(instructions, layout, error);
+    applyLayout(layout);
+}
+
+bool Process::loadProgram(const std::string& filename, std::string& error) {
+    ProgramLayout layout;
+    if (!compileProgramFile(filename, instructions, layout, error)) {
+        instructions.clear();
+        return false;
+    }
+    applyLayout(layout);
+    return true;
+}
+
+// Sizes the loop counters and variable slots for a freshly linked program
+void Process::applyLayout(const ProgramLayout& layout) {
+    lineCount = layout.lineCount;
+    loopCounters.assign(layout.loopSlots, 0);
+    variableNames = layout.variableNames;
+    variables.assign(variableNames.size(), 0);
+    variableDeclared.assign(variableNames.size(), 0);
+}
+
+int Process::currentLine() const {
+    int pc = currentInstruction();
+    if (pc >= (int)instructions.size()) return lineCount;
+    return instructions[pc].line;
+}
+
+namespace {
+
+int64_t toNanos(std::chrono::system_clock::time_point time) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(time.time_since_epoch()).count();
+}
+
+std::chrono::system_clock::time_point fromNanos(int64_t nanos) {
+    return std::chrono::system_clock::time_point(
+        std::chrono::duration_cast<std::chrono::system_clock::duration>(std::chrono::nanoseconds(nanos)));
+}
+
+void writeInts(BinaryWriter& out, const std::vector<int>& values) {
+    out.write<uint32_t>((uint32_t)values.size());
+    for (int value : values) out.write<int32_t>(value);
+}
+
+void readInts(BinaryReader& in, std::vector<int>& values) {
+    uint32_t count = in.read<uint32_t>();
+    for (uint32_t i = 0; i < count && in.good(); i++) values.push_back(in.read<int32_t>());
+}
+
+}
+
+void Process::serialize(BinaryWriter& out) const {
+    out.writeString(name);
+    out.write<int32_t>(id);
+    out.write<uint8_t>((uint8_t)state());
+    out.write<int32_t>(currentInstruction());
+    out.write<int32_t>(weightPaid);
+    out.write<int32_t>(lineCount);
+    out.write<int32_t>(coreId());
+    out.write<int32_t>(migrations);
+    out.write<int32_t>(memorySize);
+    out.write<int32_t>(readyTick);
+    out.write<int32_t>(nice);
+    out.write<int64_t>(vruntime);
+    out.write<int32_t>(tickets);
+    out.write<int64_t>(ticksRun);
+    out.write<int64_t>(deadlineMs);
+    out.write<uint8_t>(finished());
+    out.write<int64_t>(toNanos(creationTime));
+    out.write<int64_t>(toNanos(finishTime));
+
+    // Steady-clock times don't survive a restart, so store the SLEEP time still owed
+    auto sleepLeft = sleepUntil - std::chrono::steady_clock::now();
+    out.write<int64_t>(std::max<int64_t>(0, std::chrono::duration_cast<std::chrono::nanoseconds>(sleepLeft).count()));
+
+    serializeImage(out);
+}
+
+void Process::serializeImage(BinaryWriter& out) const {
+    writeInts(out, loopCounters);
+
+    out.write<uint32_t>((uint32_t)variables.size());
+    for (size_t slot = 0; slot < variables.size(); slot++) {
+        out.writeString(variableNames[slot]);
+        out.write<int32_t>(variables[slot]);
+        out.write<uint8_t>(variableDeclared[slot]);
+    }
+
+    out.write<uint32_t>((uint32_t)instructions.size());
+    for (const auto& instr : instructions) {
+        out.write<uint8_t>((uint8_t)instr.type);
+        out.writeString(instr.msg);
+        out.writeString(instr.varName);
+        out.write<int32_t>(instr.value);
+        out.write<int32_t>(instr.jumpTarget);
+        out.write<int32_t>(instr.loopSlot);
+        out.write<int32_t>(instr.varSlot);
+        out.write<int32_t>(instr.weight);
+        out.write<int32_t>(instr.line);
+    }
+
+    std::vector<PrintRecord> prints = printLog.read(0, printLog.size());
+    out.write<uint32_t>((uint32_t)prints.size());
+    for (const auto& record : prints) {
+        out.write<int64_t>(toNanos(record.time));
+        out.write<int32_t>(record.instruction);
+        out.write<int32_t>(record.coreId);
+    }
+}
+
+Process* Process::deserialize(BinaryReader& in, ProcessTable& table) {
+    std::string processName = in.readString();
+    int processId = in.read<int32_t>();
+    auto process = std::make_unique<Process>(processName, processId);
+
+    // Hot fields go into the table once the process has been added to it
+    ProcessState state = (ProcessState)in.read<uint8_t>();
+    int currentInstruction = in.read<int32_t>();
+    process->weightPaid = in.read<int32_t>();
+    process->lineCount = in.read<int32_t>();
+    int coreId = in.read<int32_t>();
+    process->migrations = in.read<int32_t>();
+    process->memorySize = in.read<int32_t>();
+    process->readyTick = in.read<int32_t>();
+    process->nice = in.read<int32_t>();
+    process->vruntime = in.read<int64_t>();
+    process->tickets = in.read<int32_t>();
+    process->ticksRun = in.read<int64_t>();
+    process->deadlineMs = in.read<int64_t>();
+    uint8_t finished = in.read<uint8_t>() != 0;
+    process->creationTime = fromNanos(in.read<int64_t>());
+    process->finishTime = fromNanos(in.read<int64_t>());
+    process->sleepUntil = std::chrono::steady_clock::now() + std::chrono::nanoseconds(in.read<int64_t>());
+
+    if (!process->deserializeImage(in)) return nullptr;
+    // The program counter may sit at the end (finished) but not past it
+    if (state > ProcessState::FINISHED || currentInstruction < 0 ||
+        currentInstruction > (int)process->instructions.size()) {
+        return nullptr;
+    }
+    // Part of a fused op may be paid for, never all of it
+    int weight = currentInstruction < (int)process->instructions.size() ? process->instructions[currentInstruction].weight : 1;
+    if (process->weightPaid < 0 || process->weightPaid >= weight) return nullptr;
+
+    Process* added = table.add(std::move(process));
+    if (!added) return nullptr;
+    added->state() = state;
+    added->currentInstruction() = currentInstruction;
+    added->coreId() = coreId;
+    added->finished() = finished;
+    return added;
+}
+
+bool Process::deserializeImage(BinaryReader& in) {
+    readInts(in, loopCounters);
+
+    uint32_t variableCount = in.read<uint32_t>();
+    for (uint32_t i = 0; i < variableCount && in.good(); i++) {
+        variableNames.push_back(in.readString());
+        variables.push_back(in.read<int32_t>());
+        variableDeclared.push_back(in.read<uint8_t>());
+    }
+
+    uint32_t instructionCount = in.read<uint32_t>();
+    for (uint32_t i = 0; i < instructionCount && in.good(); i++) {
+        InstructionType type = (InstructionType)in.read<uint8_t>();
+        const std::string& msg = in.readString();
+        const std::string& varName = in.readString();
+        int value = in.read<int32_t>();
+        instructions.emplace_back(type, msg, varName, value);
+        instructions.back().jumpTarget = in.read<int32_t>();
+        instructions.back().loopSlot = in.read<int32_t>();
+        instructions.back().varSlot = in.read<int32_t>();
+        instructions.back().weight = in.read<int32_t>();
+        instructions.back().line = in.read<int32_t>();
+    }
+
+    if (!in.good() || !validImage()) return false;
+
+    std::vector<PrintRecord> prints;
+    uint32_t printCount = in.read<uint32_t>();
+    for (uint32_t i = 0; i < printCount && in.good(); i++) {
+        PrintRecord record;
+        record.time = fromNanos(in.read<int64_t>());
+        record.instruction = in.read<int32_t>();
+        record.coreId = in.read<int32_t>();
+        // process-smi looks the message up by this index
+        if (record.instruction < 0 || record.instruction >= (int)instructions.size()) return false;
+        prints.push_back(record);
+    }
+    if (!in.good()) return false;
+    printLog.append(prints);
+    return true;
+}
+
+// Checks that every index a decoded program holds stays inside it, since the
+// interpreter follows them unchecked: types within the dispatch table, variable and
+// loop slots within their tables, and jump targets within the program (its end
+// included, which finishes it).
+bool Process::validImage() const {
+    const int end = (int)instructions.size();
+    if (variableNames.size() != variables.size() || variableDeclared.size() != variables.size()) return false;
+    for (const Instruction& instr : instructions) {
+        if (instr.weight < 0) return false;
+        switch (instr.type) {
+            case InstructionType::PRINT:
+            case InstructionType::SLEEP:
+                break;
+            case InstructionType::DECLARE:
+            case InstructionType::ADD:
+            case InstructionType::SUBTRACT:
+                if (instr.varSlot < 0 || instr.varSlot >= (int)variables.size()) return false;
+                break;
+            case InstructionType::FOR_START:
+            case InstructionType::FOR_END:
+                if (instr.loopSlot < 0 || instr.loopSlot >= (int)loopCounters.size()) return false;
+                if (instr.jumpTarget < 0 || instr.jumpTarget > end) return false;
+                break;
+            default:
+                return false;
+        }
+    }
+    return true;
+}
+
+void Process::dropImage() {
+    std::vector<int>().swap(loopCounters);
+    std::vector<std::string>().swap(variableNames);
+    std::vector<int>().swap(variables);
+    std::vector<uint8_t>().swap(variableDeclared);
+    std::vector<Instruction>().swap(instructions);
+    printLog.clear();
 }
\ No newline at end of file
@@ -5,7 +5,13 @@
 #include <vector>
 #include <map>
 #include <chrono>
-#include <optional>
+#include <memory>
+#include <mutex>
+#include <cstdint>
+#include <algorithm>
+
+class BinaryWriter;
+class BinaryReader;
 
 // Process instruction types
 enum class InstructionType {
@@ -23,39 +29,188 @@ struct Instruction {
     InstructionType type;
     std::string msg;
     std::string varName;
-    int value;
-    std::vector<Instruction> forBody;
-    int forIterations;
-    std::optional<std::chrono::system_clock::time_point> executedAt;
+    int value;       // DECLARE/ADD/SUBTRACT operand, SLEEP ticks, FOR iteration count
+    int jumpTarget;  // FOR_START: index past the matching FOR_END; FOR_END: first body index
+    int loopSlot;    // FOR_START/FOR_END: index into Process::loopCounters
+    int varSlot;     // DECLARE/ADD/SUBTRACT: index into Process::variables
+    int weight;      // source instructions this one stands for after optimizeProgram()
+    int line;        // index of the (first) source instruction it came from
+    int fileLine;    // line of the program file it was parsed from, 0 if generated
     
     Instruction(InstructionType t, const std::string& m = "", const std::string& var = "", int val = 0);
 };
 
+// Per-process storage a linked program needs (see linkProgram in Program.h)
+struct ProgramLayout {
+    int lineCount = 0; // source program length, before optimisation
+    int loopSlots = 0;
+    std::vector<std::string> variableNames; // index = variable slot
+};
+
+// One executed PRINT, as shown by process-smi
+struct PrintRecord {
+    std::chrono::system_clock::time_point time;
+    int32_t instruction; // index into Process::instructions, which holds the message
+    int32_t coreId;
+};
+
+// Append-only log of the PRINTs a process has executed. The scheduling thread appends
+// a burst's records in one go; screen sessions copy out only the slice they display.
+class PrintLog {
+public:
+    void append(const std::vector<PrintRecord>& newRecords);
+    size_t size() const;
+    // Copies up to count records starting at index first
+    std::vector<PrintRecord> read(size_t first, size_t count) const;
+    // Empties the log and gives its storage back
+    void clear();
+
+private:
+    mutable std::mutex mutex;
+    std::vector<PrintRecord> records;
+};
+
 // Process states
-enum class ProcessState {
+enum class ProcessState : uint8_t {
     READY,
     RUNNING,
     FINISHED
 };
 
-// Process class
+class ProcessTable;
+
+// Process class. The fields every scheduler scan reads (state, finished flag, core and
+// program counter) live in the owning ProcessTable, indexed by pid; the accessors below
+// are only valid once the process has been added to a table.
 class Process {
 public:
     std::string name;
     int id;
-    ProcessState state;
+    ProcessTable* table; // owning table, set by ProcessTable::add()
     std::vector<Instruction> instructions;
-    int currentInstruction;
-    std::map<std::string, int> variables;
-    int coreId;
+    int lineCount; // source program length; instructions may be shorter once optimised
+    std::vector<std::string> variableNames; // variable slot -> name, from the linker
+    std::vector<int> variables;             // values by variable slot
+    std::vector<uint8_t> variableDeclared;  // ADD/SUBTRACT only apply after DECLARE
+    int migrations;
+    int weightPaid; // budget already spent on the fused op at the program counter, paid over several bursts
+    int memorySize;         // bytes of simulated memory the process needs
+    long long memoryAddress; // base of its region while resident, -1 otherwise
+    long long swapOffset;    // where its image is in the swap file while swapped out, -1 otherwise
+    int pins;                // screen sessions keeping it in memory; guarded by the scheduler's swap lock
+    int idleEpoch;           // bumped each time it goes idle, so stale swap candidates can be told apart
+    int readyTick; // scheduler tick at which the process last entered the ready queue
+    int nice;            // cfs priority, -20 (most CPU) to 19
+    long long vruntime;  // cfs virtual runtime or stride pass; only changes while the process runs
+    int tickets;         // stride/lottery share; 0 until admission applies the ticket rules
+    long long ticksRun;  // ticks on a core under stride or lottery, for the share report
+    int shareClass;      // ticket rule it is counted under in the share report, set at admission
+    long long deadlineMs; // must finish this many ms after creationTime; 0 = no deadline
     std::chrono::system_clock::time_point creationTime;
     std::chrono::system_clock::time_point finishTime;
-    bool isFinished;
-    std::vector<int> forStack;
-    std::vector<int> forCounters;
+    std::vector<int> loopCounters; // iterations left, one slot per FOR in the program
+    std::chrono::steady_clock::time_point sleepUntil; // SLEEP wake-up time
+    PrintLog printLog;
     
     Process(const std::string& processName, int processId);
+    Process(const Process&) = delete;
+    Process& operator=(const Process&) = delete;
     void generateRandomInstructions(int minIns, int maxIns);
+    void generateRandomInstructions(int minIns, int maxIns, unsigned int seed);
+    bool loadProgram(const std::string& filename, std::string& error);
+    void applyLayout(const ProgramLayout& layout);
+    
+    // Hot fields, stored in the table
+    ProcessState& state();
+    ProcessState state() const;
+    uint8_t& finished();
+    bool finished() const;
+    int& coreId(); // core the process is on, or last ran on
+    int coreId() const;
+    int& currentInstruction();
+    int currentInstruction() const;
+    
+    // Source line the process is at, for display; lineCount once finished
+    int currentLine() const;
+    
+    // Checkpoint support (see Serialize.h). deserialize() adds the process to table.
+    void serialize(BinaryWriter& out) const;
+    static Process* deserialize(BinaryReader& in, ProcessTable& table);
+    
+    // The bulk of a process - program, variables, loop counters and PRINT log - which
+    // is what gets swapped out. Everything else stays in memory.
+    void serializeImage(BinaryWriter& out) const;
+    // False, with the image left partly read, if it is truncated or fails validImage()
+    bool deserializeImage(BinaryReader& in);
+    void dropImage();
+    bool swappedOut() const { return swapOffset >= 0; }
+
+private:
+    bool validImage() const;
 };
 
+// Owns every process, indexed by pid. Hot fields are kept structure-of-arrays in
+// fixed-size chunks so whole-table scans walk contiguous bytes; the chunk directory is
+// allocated once, so chunk addresses never move while other threads read them.
+class ProcessTable {
+public:
+    static const int kChunkShift = 10;
+    static const int kChunkSize = 1 << kChunkShift;
+    static const int kMaxChunks = 16384; // room for 16M pids
+
+    struct Chunk {
+        ProcessState state[kChunkSize];
+        uint8_t finished[kChunkSize];
+        int32_t coreId[kChunkSize];
+        int32_t currentInstruction[kChunkSize];
+    };
+
+    ProcessTable();
+    ProcessTable(const ProcessTable&) = delete;
+    ProcessTable& operator=(const ProcessTable&) = delete;
+
+    // Takes ownership of process and gives it the next pid (which must match
+    // process->id unless that is -1). Returns nullptr if the table is full or the
+    // pid does not fit.
+    Process* add(std::unique_ptr<Process> process);
+    void clear();
+    // Replaces this table's contents with other's, leaving other empty
+    void takeFrom(ProcessTable& other);
+
+    size_t size() const { return processes.size(); }
+    bool empty() const { return processes.empty(); }
+    Process* operator[](size_t pid) const { return processes[pid].get(); }
+    std::vector<std::unique_ptr<Process>>::const_iterator begin() const { return processes.begin(); }
+    std::vector<std::unique_ptr<Process>>::const_iterator end() const { return processes.end(); }
+
+    Chunk& chunk(int pid) const { return *chunks[pid >> kChunkShift]; }
+
+    size_t countFinished() const;
+
+    // Calls fn(Process*) for every finished process, in pid order
+    template <typename Fn>
+    void forEachFinished(Fn fn) const {
+        for (size_t base = 0; base < processes.size(); base += kChunkSize) {
+            const Chunk& c = *chunks[base >> kChunkShift];
+            size_t n = std::min<size_t>(kChunkSize, processes.size() - base);
+            for (size_t i = 0; i < n; i++) {
+                if (c.finished[i]) fn(processes[base + i].get());
+            }
+        }
+    }
+
+private:
+    std::unique_ptr<std::unique_ptr<Chunk>[]> chunks; // kMaxChunks slots
+    std::vector<std::unique_ptr<Process>> processes;
+};
+
+inline ProcessState& Process::state() { return table->chunk(id).state[id & (ProcessTable::kChunkSize - 1)]; }
+inline ProcessState Process::state() const { return table->chunk(id).state[id & (ProcessTable::kChunkSize - 1)]; }
+inline uint8_t& Process::finished() { return table->chunk(id).finished[id & (ProcessTable::kChunkSize - 1)]; }
+inline bool Process::finished() const { return table->chunk(id).finished[id & (ProcessTable::kChunkSize - 1)] != 0; }
+inline int& Process::coreId() { return table->chunk(id).coreId[id & (ProcessTable::kChunkSize - 1)]; }
+inline int Process::coreId() const { return table->chunk(id).coreId[id & (ProcessTable::kChunkSize - 1)]; }
+inline int& Process::currentInstruction() { return table->chunk(id).currentInstruction[id & (ProcessTable::kChunkSize - 1)]; }
+inline int Process::currentInstruction() const { return table->chunk(id).currentInstruction[id & (ProcessTable::kChunkSize - 1)]; }
+
 #endif
\ No newline at end of file
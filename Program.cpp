@@ -0,0 +1,249 @@
+#include "Program.h"
+#include "Config.h"
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <cctype>
+#include <map>
+
+namespace {
+
+// Where instr came from, for link errors: its program file line, or for a generated
+// program its source instruction index (both survive optimisation)
+std::string sourcePosition(const Instruction& instr) {
+    if (instr.fileLine > 0) return "line " + std::to_string(instr.fileLine);
+    return "instruction " + std::to_string(instr.line);
+}
+
+}
+
+bool linkProgram(std::vector<Instruction>& program, ProgramLayout& layout, std::string& error) {
+    std::vector<int> openLoops;
+    std::map<std::string, int> variableSlots;
+    layout = ProgramLayout();
+
+    for (int i = 0; i < (int)program.size(); i++) {
+        Instruction& instr = program[i];
+        if (instr.type == InstructionType::DECLARE || instr.type == InstructionType::ADD ||
+            instr.type == InstructionType::SUBTRACT) {
+            auto slot = variableSlots.find(instr.varName);
+            if (slot == variableSlots.end()) {
+                slot = variableSlots.emplace(instr.varName, (int)layout.variableNames.size()).first;
+                layout.variableNames.push_back(instr.varName);
+            }
+            instr.varSlot = slot->second;
+        } else if (instr.type == InstructionType::FOR_START) {
+            instr.loopSlot = layout.loopSlots++;
+            openLoops.push_back(i);
+        } else if (instr.type == InstructionType::FOR_END) {
+            if (openLoops.empty()) {
+                error = "END at " + sourcePosition(instr) + " has no matching FOR";
+                return false;
+            }
+            int startIndex = openLoops.back();
+            openLoops.pop_back();
+
+            // FOR_END jumps back to the first body instruction; FOR_START jumps past
+            // the FOR_END when the loop runs zero times
+            instr.loopSlot = program[startIndex].loopSlot;
+            instr.jumpTarget = startIndex + 1;
+            program[startIndex].jumpTarget = i + 1;
+        }
+    }
+
+    if (!openLoops.empty()) {
+        error = "FOR at " + sourcePosition(program[openLoops.back()]) + " has no matching END";
+        return false;
+    }
+    return true;
+}
+
+namespace {
+
+// Largest weight a folded op may carry, well inside an int; bigger folds are not done.
+// The interpreter pays a heavy op off over as many bursts as its weight needs.
+const long long kMaxWeight = 1 << 24;
+
+bool isArithmetic(const Instruction& instr) {
+    return instr.type == InstructionType::ADD || instr.type == InstructionType::SUBTRACT;
+}
+
+// Signed delta of an ADD/SUBTRACT as a wrapping 32-bit quantity
+uint32_t deltaOf(const Instruction& instr) {
+    return instr.type == InstructionType::ADD ? (uint32_t)instr.value : 0u - (uint32_t)instr.value;
+}
+
+// Appends an arithmetic op to out, merging it into the run of arithmetic ops that
+// ends out. Within such a run no variable is declared, so ops on different variables
+// commute and each variable needs just one net ADD (or another, once one is at
+// kMaxWeight). Only the first op of a run can be a jump target, and it keeps its
+// position.
+void emitArithmetic(std::vector<Instruction>& out, size_t runStart, const Instruction& instr) {
+    for (size_t i = runStart; i < out.size(); i++) {
+        if (out[i].varName == instr.varName && (long long)out[i].weight + instr.weight <= kMaxWeight) {
+            out[i].value = (int)((uint32_t)out[i].value + deltaOf(instr));
+            out[i].weight += instr.weight;
+            return;
+        }
+    }
+    Instruction fused = instr;
+    fused.type = InstructionType::ADD;
+    fused.value = (int)deltaOf(instr);
+    out.push_back(fused);
+}
+
+// Optimises program[pos..] up to the FOR_END closing the current block (or the end)
+void optimizeBlock(const std::vector<Instruction>& program, size_t& pos, std::vector<Instruction>& out) {
+    size_t runStart = out.size(); // first op of the arithmetic run ending out
+
+    while (pos < program.size()) {
+        const Instruction& instr = program[pos];
+        if (instr.type == InstructionType::FOR_END) return;
+
+        if (isArithmetic(instr)) {
+            emitArithmetic(out, runStart, instr);
+            pos++;
+            continue;
+        }
+
+        if (instr.type == InstructionType::FOR_START) {
+            const Instruction forStart = instr;
+            std::vector<Instruction> body;
+            pos++;
+            optimizeBlock(program, pos, body);
+            bool closed = pos < program.size();
+            const Instruction forEnd = closed ? program[pos] : Instruction(InstructionType::FOR_END);
+            if (closed) pos++;
+
+            bool pureArithmetic = closed && !body.empty();
+            long long bodyWeight = 0;
+            for (const auto& op : body) {
+                pureArithmetic = pureArithmetic && isArithmetic(op);
+                bodyWeight += op.weight;
+            }
+            uint32_t iterations = (uint32_t)std::max(0, forStart.value);
+            // A loop too long to charge to weights is kept as a loop
+            pureArithmetic = pureArithmetic && bodyWeight * iterations + 1 + iterations <= kMaxWeight;
+
+            if (pureArithmetic) {
+                // n iterations of the body == the body with every delta scaled by n.
+                // The FOR and the n executed ENDs are charged to the first op.
+                for (size_t i = 0; i < body.size(); i++) {
+                    Instruction scaled = body[i];
+                    scaled.value = (int)((uint32_t)scaled.value * iterations);
+                    scaled.weight = (int)(scaled.weight * (long long)iterations + (i == 0 ? 1 + (long long)iterations : 0));
+                    if (i == 0) {
+                        scaled.line = forStart.line;
+                        scaled.fileLine = forStart.fileLine;
+                    }
+                    emitArithmetic(out, runStart, scaled);
+                }
+                continue;
+            }
+
+            out.push_back(forStart);
+            out.insert(out.end(), body.begin(), body.end());
+            if (closed) out.push_back(forEnd); // unbalanced programs are left for the linker to reject
+            runStart = out.size();
+            continue;
+        }
+
+        out.push_back(instr);
+        runStart = out.size();
+        pos++;
+    }
+}
+
+}
+
+void optimizeProgram(std::vector<Instruction>& program) {
+    std::vector<Instruction> optimized;
+    size_t pos = 0;
+    while (pos < program.size()) {
+        optimizeBlock(program, pos, optimized);
+        if (pos < program.size()) {
+            optimized.push_back(program[pos++]); // stray FOR_END
+        }
+    }
+    program.swap(optimized);
+}
+
+bool buildProgram(std::vector<Instruction>& program, ProgramLayout& layout, std::string& error) {
+    for (size_t i = 0; i < program.size(); i++) {
+        program[i].line = (int)i;
+        program[i].weight = 1;
+    }
+    int lineCount = (int)program.size();
+
+    if (systemConfig.optimizePrograms) {
+        optimizeProgram(program);
+    }
+    if (!linkProgram(program, layout, error)) {
+        return false;
+    }
+    layout.lineCount = lineCount;
+    return true;
+}
+
+bool compileProgramFile(const std::string& filename, std::vector<Instruction>& program,
+                        ProgramLayout& layout, std::string& error) {
+    std::ifstream file(filename);
+    if (!file.is_open()) {
+        error = "failed to open " + filename;
+        return false;
+    }
+
+    program.clear();
+    std::string line;
+    int lineNumber = 0;
+
+    while (std::getline(file, line)) {
+        lineNumber++;
+        std::istringstream fields(line);
+        std::string op;
+        if (!(fields >> op) || op[0] == '#') continue;
+        std::transform(op.begin(), op.end(), op.begin(), [](unsigned char c) { return std::toupper(c); });
+
+        auto fail = [&](const std::string& message) {
+            error = filename + ":" + std::to_string(lineNumber) + ": " + message;
+            return false;
+        };
+
+        std::string varName;
+        int value = 0;
+        if (op == "DECLARE" || op == "ADD" || op == "SUBTRACT") {
+            if (!(fields >> varName >> value)) return fail(op + " expects <var> <value>");
+            InstructionType type = op == "DECLARE" ? InstructionType::DECLARE
+                                 : op == "ADD" ? InstructionType::ADD : InstructionType::SUBTRACT;
+            program.emplace_back(type, "", varName, value);
+        } else if (op == "PRINT") {
+            std::string msg;
+            std::getline(fields >> std::ws, msg);
+            if (msg.empty() || msg.front() != '"') {
+                msg = "\"" + msg + "\""; // displayed quoted, like generated programs
+            }
+            program.emplace_back(InstructionType::PRINT, msg);
+        } else if (op == "SLEEP") {
+            if (!(fields >> value) || value < 0) return fail("SLEEP expects a tick count");
+            program.emplace_back(InstructionType::SLEEP, "", "", value);
+        } else if (op == "FOR") {
+            if (!(fields >> value) || value < 0) return fail("FOR expects an iteration count");
+            program.emplace_back(InstructionType::FOR_START, "", "", value);
+        } else if (op == "END") {
+            program.emplace_back(InstructionType::FOR_END);
+        } else {
+            return fail("unknown instruction '" + op + "'");
+        }
+        program.back().fileLine = lineNumber;
+    }
+
+    if (program.empty()) {
+        error = filename + " has no instructions";
+        return false;
+    }
+    if (!buildProgram(program, layout, error)) {
+        error = filename + ": " + error;
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,42 @@
+#ifndef PROGRAM_H
+#define PROGRAM_H
+
+#include <string>
+#include <vector>
+#include "Process.h"
+
+// Process program text format, one instruction per line:
+//
+//     DECLARE <var> <value>
+//     ADD <var> <value>
+//     SUBTRACT <var> <value>
+//     PRINT "<message>"
+//     SLEEP <ticks>
+//     FOR <iterations>
+//         ...
+//     END
+//
+// FOR blocks may nest. Blank lines and lines starting with '#' are ignored.
+
+// Resolves every FOR_START/FOR_END pair into direct jumps and gives each loop its own
+// counter slot, so execution needs no loop stack. Variable names are resolved to slots
+// the same way. Returns false if loops are unbalanced.
+bool linkProgram(std::vector<Instruction>& program, ProgramLayout& layout, std::string& error);
+
+// Folds straight-line arithmetic and pure-arithmetic loops into fewer instructions.
+// Each consecutive run of ADD/SUBTRACT collapses to one ADD per variable carrying the
+// net (wrapping) delta, and a FOR whose body reduces to such ops collapses to the
+// body scaled by the iteration count. Instruction::weight keeps the number of source
+// instructions each result stands for and Instruction::line its source position, so
+// retired-instruction counts and displayed progress are unchanged.
+void optimizeProgram(std::vector<Instruction>& program);
+
+// Numbers the source lines, runs optimizeProgram() when optimize-programs is on and
+// links the result.
+bool buildProgram(std::vector<Instruction>& program, ProgramLayout& layout, std::string& error);
+
+// Parses and builds a program file into program.
+bool compileProgramFile(const std::string& filename, std::vector<Instruction>& program,
+                        ProgramLayout& layout, std::string& error);
+
+#endif
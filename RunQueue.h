@@ -0,0 +1,395 @@
+#ifndef RUN_QUEUE_H
+#define RUN_QUEUE_H
+
+#include <deque>
+#include <set>
+#include <vector>
+#include <unordered_map>
+#include <random>
+#include <climits>
+#include <chrono>
+#include <functional>
+#include <algorithm>
+#include "Process.h"
+
+// The ready processes of one scheduler domain, in the order its policy dispatches
+// them. The scheduling loop is compiled against its policy's concrete queue type and
+// calls it directly; arrivals, the balancer, checkpoints and reports go through this
+// interface. Not thread-safe: the domain's queueMutex guards it.
+class RunQueue {
+public:
+    virtual ~RunQueue() = default;
+
+    virtual size_t size() const = 0;
+    bool empty() const { return size() == 0; }
+
+    // Adds an arriving or preempted process in policy order
+    virtual void push(Process* process) = 0;
+    // Adds a process that was running when a checkpoint was taken, ahead of the ones
+    // that were waiting where the policy's order allows it
+    virtual void pushFront(Process* process) = 0;
+    // Removes and returns the process that would be dispatched last; nullptr if empty
+    virtual Process* popBack() = 0;
+    virtual void clear() = 0;
+
+    // Calls fn for each process in dispatch order (or the reverse) until it returns false
+    virtual void visit(const std::function<bool(Process*)>& fn) const = 0;
+    virtual void visitFromBack(const std::function<bool(Process*)>& fn) const = 0;
+};
+
+// Arrival order, for fcfs and rr
+class FifoRunQueue final : public RunQueue {
+public:
+    size_t size() const override { return queue.size(); }
+    void push(Process* process) override { queue.push_back(process); }
+    void pushFront(Process* process) override { queue.push_front(process); }
+
+    Process* popBack() override {
+        if (queue.empty()) return nullptr;
+        Process* process = queue.back();
+        queue.pop_back();
+        return process;
+    }
+
+    void clear() override { queue.clear(); }
+
+    void visit(const std::function<bool(Process*)>& fn) const override {
+        for (Process* process : queue) {
+            if (!fn(process)) return;
+        }
+    }
+
+    void visitFromBack(const std::function<bool(Process*)>& fn) const override {
+        for (auto it = queue.rbegin(); it != queue.rend(); ++it) {
+            if (!fn(*it)) return;
+        }
+    }
+
+    // Dispatch side, used by the scheduling loop. beginDispatch() is called once per
+    // dispatch, before its front() and find() calls; front() requires a non-empty queue.
+    void beginDispatch() {}
+    Process* front() const { return queue.front(); }
+
+    // First of the next depth processes for which match holds, or nullptr
+    template <typename Fn>
+    Process* find(int depth, Fn match) const {
+        int scanned = 0;
+        for (auto it = queue.begin(); it != queue.end() && scanned < depth; ++it, ++scanned) {
+            if (match(*it)) return *it;
+        }
+        return nullptr;
+    }
+
+    // Takes process, which find() or front() returned, out of the queue
+    void remove(Process* process) {
+        queue.erase(std::find(queue.begin(), queue.end(), process));
+    }
+
+private:
+    std::deque<Process*> queue;
+};
+
+// Ordered by virtual runtime (cfs) or pass (stride), least first: dispatch, insertion
+// and removal are O(log n) however many processes are ready. A process's vruntime only
+// changes while it runs, i.e. while it is out of the tree.
+class VruntimeRunQueue final : public RunQueue {
+public:
+    size_t size() const override { return tree.size(); }
+
+    // A process joining (new, woken on another domain, or moved by the balancer) is
+    // placed no earlier than the queue's minimum, so it cannot claim CPU time for the
+    // time it was not here
+    void push(Process* process) override {
+        process->vruntime = std::max(process->vruntime, minVruntime);
+        tree.insert(process);
+    }
+    void pushFront(Process* process) override { tree.insert(process); }
+
+    Process* popBack() override {
+        if (tree.empty()) return nullptr;
+        Process* process = *tree.rbegin();
+        tree.erase(std::prev(tree.end()));
+        return process;
+    }
+
+    void clear() override {
+        tree.clear();
+        minVruntime = 0;
+    }
+
+    void visit(const std::function<bool(Process*)>& fn) const override {
+        for (Process* process : tree) {
+            if (!fn(process)) return;
+        }
+    }
+
+    void visitFromBack(const std::function<bool(Process*)>& fn) const override {
+        for (auto it = tree.rbegin(); it != tree.rend(); ++it) {
+            if (!fn(*it)) return;
+        }
+    }
+
+    void beginDispatch() {}
+    Process* front() const { return *tree.begin(); }
+
+    template <typename Fn>
+    Process* find(int depth, Fn match) const {
+        int scanned = 0;
+        for (auto it = tree.begin(); it != tree.end() && scanned < depth; ++it, ++scanned) {
+            if (match(*it)) return *it;
+        }
+        return nullptr;
+    }
+
+    // Takes process out for dispatch. The queue's minimum only moves forward, to the
+    // least vruntime among the dispatched process and those left waiting.
+    void remove(Process* process) {
+        tree.erase(process);
+        long long least = process->vruntime;
+        if (!tree.empty()) least = std::min(least, front()->vruntime);
+        minVruntime = std::max(minVruntime, least);
+    }
+
+private:
+    struct ByVruntime {
+        bool operator()(const Process* a, const Process* b) const {
+            return a->vruntime != b->vruntime ? a->vruntime < b->vruntime : a->id < b->id;
+        }
+    };
+
+    std::set<Process*, ByVruntime> tree;
+    long long minVruntime = 0;
+};
+
+// For lottery: each dispatch draws a ticket uniformly from those the ready processes
+// hold. Processes sit in a dense slot array with a Fenwick tree of ticket counts over
+// it, so a draw, an insertion and a removal are each O(log n).
+class LotteryRunQueue final : public RunQueue {
+public:
+    size_t size() const override { return slots.size(); }
+
+    void push(Process* process) override {
+        if (slots.size() == capacity) grow();
+        slotOf[process] = slots.size();
+        slots.push_back(process);
+        add(slots.size() - 1, ticketsOf(process));
+    }
+    // A lottery has no front to put a process back at
+    void pushFront(Process* process) override { push(process); }
+
+    Process* popBack() override {
+        if (slots.empty()) return nullptr;
+        Process* process = slots.back();
+        remove(process);
+        return process;
+    }
+
+    void clear() override {
+        slots.clear();
+        slotOf.clear();
+        winner = nullptr;
+        std::fill(fenwick.begin(), fenwick.end(), 0);
+        totalTickets = 0;
+    }
+
+    void visit(const std::function<bool(Process*)>& fn) const override {
+        for (Process* process : slots) {
+            if (!fn(process)) return;
+        }
+    }
+
+    void visitFromBack(const std::function<bool(Process*)>& fn) const override {
+        for (auto it = slots.rbegin(); it != slots.rend(); ++it) {
+            if (!fn(*it)) return;
+        }
+    }
+
+    // Draws this dispatch's winner. Requires a non-empty queue.
+    void beginDispatch() { winner = slots[draw()]; }
+    Process* front() const { return winner; }
+
+    // Only the winner is ever offered: passing it over for a process that suits the
+    // core or fits in memory better would skew shares toward those. A winner that
+    // cannot be placed waits for the next draw.
+    template <typename Fn>
+    Process* find(int, Fn match) const {
+        return winner && match(winner) ? winner : nullptr;
+    }
+
+    // The last slot's process moves into the freed one, keeping the slots dense
+    void remove(Process* process) {
+        if (process == winner) winner = nullptr;
+        auto it = slotOf.find(process);
+        size_t slot = it->second;
+        size_t last = slots.size() - 1;
+        slotOf.erase(it);
+        add(slot, -ticketsOf(process));
+        if (slot != last) {
+            Process* moved = slots[last];
+            add(last, -ticketsOf(moved));
+            add(slot, ticketsOf(moved));
+            slots[slot] = moved;
+            slotOf[moved] = slot;
+        }
+        slots.pop_back();
+    }
+
+private:
+    static long long ticketsOf(const Process* process) { return std::max(process->tickets, 1); }
+
+    // Fenwick tree over slots (1-based internally)
+    void add(size_t slot, long long delta) {
+        totalTickets += delta;
+        for (size_t i = slot + 1; i <= capacity; i += i & (0 - i)) fenwick[i] += delta;
+    }
+
+    // Doubles the capacity and rebuilds the tree from the slots, O(n) amortized away
+    void grow() {
+        capacity = std::max<size_t>(capacity * 2, 64);
+        fenwick.assign(capacity + 1, 0);
+        totalTickets = 0;
+        for (size_t slot = 0; slot < slots.size(); slot++) add(slot, ticketsOf(slots[slot]));
+    }
+
+    // Slot holding the winning ticket: the first whose prefix sum exceeds it
+    size_t draw() {
+        long long ticket = std::uniform_int_distribution<long long>(0, totalTickets - 1)(rng);
+        size_t pos = 0;
+        size_t step = 1;
+        while (step * 2 <= capacity) step *= 2;
+        for (; step > 0; step /= 2) {
+            if (pos + step <= capacity && fenwick[pos + step] <= ticket) {
+                pos += step;
+                ticket -= fenwick[pos];
+            }
+        }
+        return pos; // 1-based pos + 1, as a 0-based slot
+    }
+
+    std::vector<Process*> slots;
+    std::unordered_map<Process*, size_t> slotOf;
+    std::vector<long long> fenwick;
+    size_t capacity = 0;
+    long long totalTickets = 0;
+    Process* winner = nullptr; // drawn by beginDispatch()
+    std::mt19937_64 rng{0x5eed}; // fixed, so a replayed trace draws the same way
+};
+
+// For edf: a binary min-heap on absolute deadline, with processes that have none
+// after every one that does, in arrival order. An index of heap positions lets the
+// loop remove whichever process it dispatches in O(log n). visit() and find() walk the
+// heap array, which starts with the earliest deadline but is otherwise only loosely
+// ordered.
+class DeadlineRunQueue final : public RunQueue {
+public:
+    // Unix ms by which process must finish; LLONG_MAX if it has no deadline
+    static long long deadlineOf(const Process* process) {
+        if (process->deadlineMs <= 0) return LLONG_MAX;
+        return std::chrono::duration_cast<std::chrono::milliseconds>(process->creationTime.time_since_epoch()).count() +
+               process->deadlineMs;
+    }
+
+    size_t size() const override { return heap.size(); }
+
+    void push(Process* process) override { insert(process, nextSeq++); }
+    // Ahead of everything already queued with the same deadline
+    void pushFront(Process* process) override { insert(process, --frontSeq); }
+
+    Process* popBack() override {
+        if (heap.empty()) return nullptr;
+        Process* process = heap.back().process;
+        remove(process);
+        return process;
+    }
+
+    void clear() override {
+        heap.clear();
+        position.clear();
+    }
+
+    void visit(const std::function<bool(Process*)>& fn) const override {
+        for (const Entry& entry : heap) {
+            if (!fn(entry.process)) return;
+        }
+    }
+
+    // Leaves first: the processes furthest from running
+    void visitFromBack(const std::function<bool(Process*)>& fn) const override {
+        for (auto it = heap.rbegin(); it != heap.rend(); ++it) {
+            if (!fn(it->process)) return;
+        }
+    }
+
+    void beginDispatch() {}
+    Process* front() const { return heap.front().process; }
+
+    template <typename Fn>
+    Process* find(int depth, Fn match) const {
+        for (size_t i = 0; i < heap.size() && (int)i < depth; i++) {
+            if (match(heap[i].process)) return heap[i].process;
+        }
+        return nullptr;
+    }
+
+    void remove(Process* process) {
+        auto it = position.find(process);
+        size_t i = it->second;
+        position.erase(it);
+        Entry last = heap.back();
+        heap.pop_back();
+        if (i == heap.size()) return;
+        place(i, last);
+        siftUp(i);
+        siftDown(position[last.process]);
+    }
+
+private:
+    struct Entry {
+        long long deadline;
+        long long seq; // arrival order among equal deadlines
+        Process* process;
+        bool before(const Entry& other) const {
+            return deadline != other.deadline ? deadline < other.deadline : seq < other.seq;
+        }
+    };
+
+    void insert(Process* process, long long seq) {
+        heap.push_back({deadlineOf(process), seq, process});
+        position[process] = heap.size() - 1;
+        siftUp(heap.size() - 1);
+    }
+
+    void place(size_t i, const Entry& entry) {
+        heap[i] = entry;
+        position[entry.process] = i;
+    }
+
+    void siftUp(size_t i) {
+        Entry entry = heap[i];
+        while (i > 0 && entry.before(heap[(i - 1) / 2])) {
+            place(i, heap[(i - 1) / 2]);
+            i = (i - 1) / 2;
+        }
+        place(i, entry);
+    }
+
+    void siftDown(size_t i) {
+        Entry entry = heap[i];
+        for (;;) {
+            size_t child = 2 * i + 1;
+            if (child >= heap.size()) break;
+            if (child + 1 < heap.size() && heap[child + 1].before(heap[child])) child++;
+            if (!heap[child].before(entry)) break;
+            place(i, heap[child]);
+            i = child;
+        }
+        place(i, entry);
+    }
+
+    std::vector<Entry> heap;
+    std::unordered_map<Process*, size_t> position;
+    long long nextSeq = 0;
+    long long frontSeq = 0;
+};
+
+#endif
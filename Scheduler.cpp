@@ -1,5 +1,8 @@
 #include "Scheduler.h"
 #include "Config.h"
+#include "Serialize.h"
+#include "Program.h"
+#include "Console.h"
 #include <iostream>
 #include <fstream>
 #include <sstream>
@@ -8,64 +11,443 @@
 #include <algorithm>
 #include <filesystem>
 #include <ctime>
+#include <optional>
 
 // Global scheduler instance
 Scheduler globalScheduler;
 
 // CPUCore implementation
-CPUCore::CPUCore(int coreId) : id(coreId), currentProcess(nullptr), isRunning(false), currentQuantum(0) {}
+CPUCore::CPUCore(int coreId) : id(coreId), slot(0), currentProcess(nullptr), isRunning(false), currentQuantum(0), draining(false), switchCycles(0), warmupCycles(0) {}
+
+// SchedulerDomain implementation
+SchedulerDomain::SchedulerDomain(int domainId) : id(domainId), queueLockName("ready queue " + std::to_string(domainId)),
+                                                 queueStats(queueLockName.c_str()), wakePending(false), windowBusyCycles(0),
+                                                 windowSwitchCycles(0), windowDispatches(0), windowWaitTicks(0),
+                                                 balancedIn(0), balancedOut(0) {}
 
 // Scheduler implementation
-Scheduler::Scheduler() : isInitialized(false), isRunning(false), allProcessesFinishedMessageShown(false), processCounter(0), cpuTicks(0) {}
+Scheduler::Scheduler() : isInitialized(false), isRunning(false), allProcessesFinishedMessageShown(false), liveProcesses(0), cpuTicks(0), nextClockTick(0), configVersion(0),
+                         migrationCount(0), warmupCycleCount(0), contextSwitchCount(0), switchCycleCount(0), retiredInstructions(0), quantumCycles(0), activePolicy(nullptr) {}
 
 bool Scheduler::initialize() {
+    if (isRunning) {
+        // The scheduling threads work on the current domains
+        std::cout << "Stop the scheduler before initializing again.\n";
+        return false;
+    }
+    const PolicyEntry* policy = findPolicy(systemConfig.scheduler);
+    if (!policy) {
+        std::cout << "Unknown scheduler '" << systemConfig.scheduler << "' (expected " << policyNames() << ").\n";
+        return false;
+    }
+    if (!memory.configure(systemConfig.memAllocator, systemConfig.maxOverallMem)) {
+        std::cout << "Unknown mem-allocator '" << systemConfig.memAllocator
+                  << "' (expected first-fit, best-fit or buddy).\n";
+        return false;
+    }
+    {
+        // A fresh address space: nothing is resident any more. Swapped-out processes
+        // come back in before the swap file is replaced.
+        TimedSharedLock lock(tableMutex, tableSharedStats);
+        std::lock_guard<std::mutex> swapLock(swapMutex);
+        for (const auto& processPtr : allProcesses) {
+            processPtr->memoryAddress = -1;
+            if (processPtr->swappedOut()) swapIn(processPtr.get());
+        }
+        swap.close();
+        if (systemConfig.swapThresholdMs > 0 && !swap.open(systemConfig.swapFile)) {
+            std::cout << "Failed to create swap file " << systemConfig.swapFile << ".\n";
+            return false;
+        }
+    }
+    if (!configureTickets(systemConfig.tickets)) {
+        return false;
+    }
+    configureStatsServer();
+    configureUtilizationLog();
+
+    // Processes still queued from before carry over, spread over the new domains and
+    // into the new policy's queues. Ones the old cores were running join them behind,
+    // as if preempted.
+    std::vector<Process*> queued;
+    for (auto& domain : domains) {
+        domain.readyQueue->visit([&](Process* process) {
+            queued.push_back(process);
+            return true;
+        });
+    }
+    for (auto& core : cores) {
+        Process* process = core.currentProcess;
+        if (!process || process->finished()) continue;
+        process->state() = ProcessState::READY;
+        process->readyTick = cpuTicks;
+        queued.push_back(process);
+    }
+
     cores.clear();
     for (int i = 0; i < systemConfig.numCPU; i++) {
         cores.emplace_back(i);
     }
+    domains.clear();
+    activePolicy = policy;
+    int domainCount = std::max(1, std::min(systemConfig.domains, systemConfig.numCPU));
+    for (int i = 0; i < domainCount; i++) {
+        domains.emplace_back(i);
+        domains.back().readyQueue = activePolicy->makeQueue();
+    }
+    assignCoresToDomains();
+    for (Process* process : queued) {
+        domains[process->id % domainCount].readyQueue->push(process);
+    }
     
+    quantumCycles = systemConfig.quantumCycles;
     isInitialized = true;
     startTime = std::chrono::system_clock::now();
     std::cout << "Scheduler initialized with " << systemConfig.numCPU << " CPU cores.\n";
     std::cout << "Scheduler algorithm: " << systemConfig.scheduler << "\n";
-    std::cout << "Quantum cycles: " << systemConfig.quantumCycles << "\n";
+    std::cout << "Quantum cycles: " << quantumCycles << "\n";
+    if (domains.size() > 1) {
+        std::cout << "Scheduler domains: " << domains.size() << "\n";
+    }
+    if (memory.enabled()) {
+        std::cout << "Memory: " << memory.total() << " bytes, " << systemConfig.memAllocator << "\n";
+    }
+    if (swap.isOpen()) {
+        std::cout << "Swap: " << systemConfig.swapFile << " after " << systemConfig.swapThresholdMs << " ms idle\n";
+    }
+    if (utilLog.isOpen()) {
+        std::cout << "Utilization log: " << systemConfig.logFile << " every " << systemConfig.logIntervalMs << " ms\n";
+    }
     return true;
 }
 
+void Scheduler::reloadConfig(const Config& newConfig) {
+    if (!isInitialized) {
+        std::cout << "Please initialize the scheduler first.\n";
+        return;
+    }
+
+    int oldCPU;
+    bool policyChanged;
+    {
+        TimedUniqueLock<std::shared_mutex> lock(coreMutex, coreExclusiveStats);
+        oldCPU = (int)cores.size();
+        // The domains' loops and queues are built for the policy chosen at initialize
+        policyChanged = newConfig.scheduler != activePolicy->name;
+        systemConfig = newConfig;
+        systemConfig.scheduler = activePolicy->name;
+        quantumCycles = systemConfig.quantumCycles; // a reload drops the tuned value
+        resizeCores(systemConfig.numCPU);
+    }
+    {
+        std::lock_guard<std::mutex> wake(wakeMutex);
+        configVersion++;
+    }
+    schedulerCV.notify_all(); // let the generation loop restart its wait with the new period
+    configureTickets(systemConfig.tickets);
+    configureStatsServer();
+    configureUtilizationLog();
+
+    std::cout << "Configuration reloaded.\n";
+    std::cout << "Scheduler algorithm: " << systemConfig.scheduler;
+    if (policyChanged) {
+        std::cout << " (a different scheduler takes effect at the next initialize)";
+    }
+    std::cout << "\n";
+    std::cout << "Quantum cycles: " << quantumCycles << "\n";
+    if (systemConfig.numCPU > oldCPU) {
+        std::cout << "Added " << (systemConfig.numCPU - oldCPU) << " CPU core(s).\n";
+    } else if (systemConfig.numCPU < oldCPU) {
+        std::cout << "Draining " << (oldCPU - systemConfig.numCPU)
+                  << " CPU core(s); their processes finish or are preempted back to the ready queue.\n";
+    }
+}
+
+// Grows or shrinks the core set to numCPU. Surplus cores are only marked draining so
+// the process on them is never dropped; removeDrainedCores() deletes them once idle.
+void Scheduler::resizeCores(int numCPU) {
+    for (auto& core : cores) {
+        core.draining = core.id >= numCPU;
+    }
+    while ((int)cores.size() < numCPU) {
+        cores.emplace_back((int)cores.size());
+    }
+    removeDrainedCores();
+}
+
+void Scheduler::removeDrainedCores() {
+    // Core ids equal their index, so draining cores always sit at the back
+    while (!cores.empty() && cores.back().draining && !cores.back().currentProcess) {
+        cores.pop_back();
+    }
+    assignCoresToDomains();
+}
+
+// Core i belongs to domain i % domain count. Also rebuilds each domain's core masks
+// and release lists from the cores' state. Caller holds coreMutex exclusively (or
+// nothing runs yet).
+void Scheduler::assignCoresToDomains() {
+    for (auto& domain : domains) {
+        domain.cores.clear();
+        domain.finishedCores.clear();
+        domain.expiredCores.clear();
+    }
+    for (auto& core : cores) {
+        SchedulerDomain& domain = domains[core.id % domains.size()];
+        core.slot = (int)domain.cores.size();
+        domain.cores.push_back(&core);
+    }
+    for (auto& domain : domains) {
+        domain.idleCores.resize(domain.cores.size());
+        domain.busyCores.resize(domain.cores.size());
+        for (CPUCore* core : domain.cores) {
+            Process* process = core->currentProcess;
+            if (!process) {
+                if (!core->draining) domain.idleCores.set(core->slot);
+                continue;
+            }
+            domain.busyCores.set(core->slot);
+            if (process->finished()) {
+                domain.finishedCores.push_back(core->slot);
+            } else if (core->currentQuantum >= quantumCycles) {
+                domain.expiredCores.push_back(core->slot);
+            }
+        }
+    }
+}
+
 void Scheduler::schedulerTest() {
     if (!isInitialized) {
         std::cout << "Please initialize the scheduler first.\n";
         return;
     }
     
-    isRunning = true;
-    allProcessesFinishedMessageShown = false; // Reset flag when starting
+    startSchedulingLoop();
     std::cout << "Scheduler started.\n";
     
-    std::thread schedulingThread(&Scheduler::schedulingLoop, this);
-    schedulingThread.detach();
-    
     std::thread processGenThread(&Scheduler::processGenerationLoop, this);
     processGenThread.detach();
 }
 
+// Starts one scheduling thread per domain, plus the balancer when there are several,
+// unless they are already running (e.g. under a replay)
+void Scheduler::startSchedulingLoop() {
+    std::lock_guard<std::mutex> wake(wakeMutex);
+    if (isRunning) return;
+
+    isRunning = true;
+    allProcessesFinishedMessageShown = false; // Reset flag when starting
+    for (auto& domain : domains) {
+        domain.wakePending = false;
+        std::thread schedulingThread(activePolicy->loop, this, std::ref(domain));
+        schedulingThread.detach();
+    }
+    if (domains.size() > 1) {
+        std::thread balanceThread(&Scheduler::balanceLoop, this);
+        balanceThread.detach();
+    }
+    std::thread logThread(&Scheduler::utilizationLogLoop, this);
+    logThread.detach();
+}
+
 void Scheduler::schedulerStop() {
-    isRunning = false;
+    {
+        std::lock_guard<std::mutex> wake(wakeMutex);
+        isRunning = false;
+    }
+    schedulerCV.notify_all(); // wake the scheduling and generation loops so they exit now
+    if (statsServer.running()) {
+        TimedSharedLock coreLock(coreMutex, coreSharedStats);
+        publishStats(); // pollers see the scheduler stop rather than a frozen last tick
+    }
     std::cout << "Scheduler stopped.\n";
 }
 
 void Scheduler::addProcess(const std::string& processName) {
-    std::lock_guard<std::mutex> lock(schedulerMutex);
-
-    auto process = std::make_unique<Process>(processName, processCounter++);
+    auto process = std::make_unique<Process>(processName, -1);
     process->generateRandomInstructions(systemConfig.minInstructions, systemConfig.maxInstructions); // Generate process instructions
-    readyQueue.push(process.get()); // Push raw pointer to queue
-    allProcesses.push_back(std::move(process)); // Transfer ownership to vector
-    
+    addProcess(std::move(process));
+}
+
+// Admits a fully built process: assigns its id and queues it. Programs are generated
+// by the caller, and the table and queue are locked one after the other, so an arrival
+// never waits for instructions to execute.
+void Scheduler::addProcess(std::unique_ptr<Process> process) {
+    process->id = -1; // the table hands out the next pid
+    process->readyTick = cpuTicks;
+
+    Process* added;
+    {
+        TimedUniqueLock<std::shared_mutex> lock(tableMutex, tableExclusiveStats);
+        added = allProcesses.add(std::move(process)); // Transfer ownership to the table
+        if (added) {
+            if (added->tickets == 0) {
+                const TicketRule* rule = findTicketRule(added->name);
+                added->tickets = rule ? rule->tickets : kDefaultTickets;
+            }
+            processIndex.emplace(added->name, added);
+            liveProcesses++;
+            addToTotals(added);
+            if (added->memorySize == 0) {
+                // Drawn from the pid so a replayed trace gets the same sizes every run
+                std::mt19937 rng((unsigned int)added->id);
+                int hi = std::max(1, systemConfig.maxMemPerProc);
+                if (memory.enabled()) {
+                    hi = (int)std::min<long long>(hi, memory.total()); // must fit in an empty memory
+                }
+                int lo = std::min(std::max(1, systemConfig.minMemPerProc), hi);
+                added->memorySize = std::uniform_int_distribution<int>(lo, hi)(rng);
+            }
+        }
+    }
+    if (!added) {
+        console.notice("Process table is full.");
+        return;
+    }
+
+    // Arrivals are dealt round-robin by pid; the balancer evens out what that misses
+    SchedulerDomain& domain = domains[added->id % domains.size()];
+    {
+        TimedUniqueLock<std::mutex> lock(domain.queueMutex, domain.queueStats);
+        domain.readyQueue->push(added); // Push raw pointer to queue
+    }
+    queueSwapCandidate(domain, added);
+    {
+        std::lock_guard<std::mutex> wake(wakeMutex);
+        domain.wakePending = true;
+    }
+    schedulerCV.notify_all(); // dispatch immediately instead of waiting for the next tick
 }
 
+// Streams a workload trace into the scheduler. Each non-comment line is
+//     <arrival-ms> <name> <instruction-count> <seed>
+// and yields a process with a program generated from seed, so a trace reproduces
+// the same workload every time, or
+//     <arrival-ms> <name> @<program-file>
+// to run a program file (compiled once per distinct file). Lines are read one at a
+// time, so memory use does not depend on the trace length. speed scales the arrival
+// clock (2 = twice as fast); 0 admits every arrival as fast as possible.
+void Scheduler::replay(const std::string& filename, double speed) {
+    if (!isInitialized) {
+        std::cout << "Please initialize the scheduler first.\n";
+        return;
+    }
+
+    std::ifstream probe(filename);
+    if (!probe.is_open()) {
+        std::cout << "Failed to open " << filename << ".\n";
+        return;
+    }
+    probe.close();
+
+    startSchedulingLoop();
+    std::cout << "Replaying " << filename;
+    if (speed > 0) {
+        std::cout << " at " << speed << "x speed.\n";
+    } else {
+        std::cout << " at full speed.\n";
+    }
+
+    std::thread replayThread(&Scheduler::replayLoop, this, filename, speed);
+    replayThread.detach();
+}
+
+void Scheduler::replayLoop(std::string filename, double speed) {
+    std::ifstream trace(filename);
+    auto start = std::chrono::steady_clock::now();
+    long long arrivals = 0;
+    long long badLines = 0;
+    std::string line;
+
+    struct CompiledProgram {
+        std::vector<Instruction> instructions;
+        ProgramLayout layout;
+    };
+    std::map<std::string, CompiledProgram> programCache;
+
+    while (std::getline(trace, line)) {
+        std::istringstream fields(line);
+        double arrivalMs;
+        std::string processName, program;
+        int instructionCount = 0;
+        unsigned int seed = 0;
+
+        if (line.empty() || line[0] == '#') continue;
+        if (!(fields >> arrivalMs >> processName >> program)) {
+            badLines++;
+            continue;
+        }
+
+        const CompiledProgram* compiled = nullptr;
+        if (program[0] == '@') {
+            auto cached = programCache.find(program);
+            if (cached == programCache.end()) {
+                CompiledProgram entry;
+                std::string error;
+                if (!compileProgramFile(program.substr(1), entry.instructions, entry.layout, error)) {
+                    console.notice("Replay: " + error);
+                    badLines++;
+                    continue;
+                }
+                cached = programCache.emplace(program, std::move(entry)).first;
+            }
+            compiled = &cached->second;
+        } else {
+            std::istringstream countField(program);
+            if (!(countField >> instructionCount) || !(fields >> seed) || instructionCount < 1) {
+                badLines++;
+                continue;
+            }
+        }
+        // Optional trailing deadline=<ms>, relative to arrival
+        long long deadlineMs = 0;
+        std::string option;
+        while (fields >> option) {
+            if (option.rfind("deadline=", 0) == 0) {
+                std::istringstream value(option.substr(9));
+                if (!(value >> deadlineMs) || deadlineMs < 1) deadlineMs = -1;
+            }
+        }
+        if (deadlineMs < 0) {
+            badLines++;
+            continue;
+        }
+
+        if (speed > 0) {
+            auto arrival = start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                std::chrono::duration<double, std::milli>(arrivalMs / speed));
+            std::unique_lock<std::mutex> wake(wakeMutex);
+            schedulerCV.wait_until(wake, arrival, [this] { return !isRunning; });
+        }
+        if (!isRunning) break;
+
+        auto process = std::make_unique<Process>(processName, -1);
+        if (compiled) {
+            process->instructions = compiled->instructions;
+            process->applyLayout(compiled->layout);
+        } else {
+            process->generateRandomInstructions(instructionCount, instructionCount, seed);
+        }
+        process->deadlineMs = deadlineMs;
+        addProcess(std::move(process));
+        arrivals++;
+    }
+
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::ostringstream summary;
+    summary << "Replay of " << filename << " " << (isRunning ? "finished" : "stopped") << ": "
+            << arrivals << " arrivals in " << elapsed << "s";
+    if (badLines > 0) {
+        summary << " (" << badLines << " malformed lines skipped)";
+    }
+    console.notice(summary.str());
+}
+
+// Observers take only shared locks: the running list reads each core's published
+// process, and the table lock is held just long enough to collect the finished ones.
+// Progress counts are read unsynchronised and may be a burst behind.
 void Scheduler::printScreen() {
-    std::lock_guard<std::mutex> lock(schedulerMutex);
+    TimedSharedLock coreLock(coreMutex, coreSharedStats);
     
     std::cout << "\n";    
     auto now = std::chrono::system_clock::now();
@@ -74,14 +456,20 @@ void Scheduler::printScreen() {
     
     std::cout << "CPU utilization: " << calculateCPUUtilization() << "%\n";
     std::cout << "Cores used: " << getActiveCores() << "\n";
-    std::cout << "Cores available: " << (systemConfig.numCPU - getActiveCores()) << "\n\n";
+    std::cout << "Cores available: " << ((int)cores.size() - getActiveCores()) << "\n";
+    std::cout << "Migrations: " << migrationCount << " (" << warmupCycleCount << " warm-up cycles)\n";
+    std::cout << "Context switches: " << contextSwitchCount << " (" << switchCycleCount << " overhead cycles)\n";
+    std::cout << "Instructions retired: " << retiredInstructions << "\n";
+    printDomains(std::cout);
+    printShares(std::cout);
+    std::cout << "Quantum cycles: " << quantumCycles
+              << (systemConfig.quantumAutotune ? " (auto-tuned)" : "") << "\n\n";
     
     std::cout << "----------------------------------------\n";
     std::cout << "Running processes:\n";
     for (const auto& core : cores) {
-        if (core.currentProcess) {
-            auto process = core.currentProcess;
-            auto currentTime = std::chrono::system_clock::now();
+        Process* process = core.currentProcess;
+        if (process) {
             auto time_t = std::chrono::system_clock::to_time_t(process->creationTime);
             
             // Format timestamp into string
@@ -93,7 +481,7 @@ void Scheduler::printScreen() {
             std::string coreStr = "Core: " + std::to_string(core.id);
 
             // Format instruction progress
-            std::string progressStr = std::to_string(process->currentInstruction) + " / " + std::to_string(process->instructions.size());
+            std::string progressStr = std::to_string(process->currentLine()) + " / " + std::to_string(process->lineCount);
 
             std::cout << std::left
                       << std::setw(12) << process->name
@@ -103,14 +491,16 @@ void Scheduler::printScreen() {
                       << "\n";
         }
     }
+    coreLock.unlock();
     
     std::cout << "\nFinished processes:\n";
 
     std::vector<const Process*> finishedProcesses;
-    for (const auto& processPtr : allProcesses) {
-        if (processPtr->isFinished) {
-            finishedProcesses.push_back(processPtr.get());
-        }
+    {
+        TimedSharedLock lock(tableMutex, tableSharedStats);
+        allProcesses.forEachFinished([&](const Process* process) {
+            finishedProcesses.push_back(process);
+        });
     }
 
     std::sort(finishedProcesses.begin(), finishedProcesses.end(), [](const Process* a, const Process* b) {
@@ -126,7 +516,7 @@ void Scheduler::printScreen() {
         std::string timeStr = timeStream.str();
 
         // Format instruction progress
-        std::string progressStr = std::to_string(process->instructions.size()) + " / " + std::to_string(process->instructions.size());
+        std::string progressStr = std::to_string(process->lineCount) + " / " + std::to_string(process->lineCount);
 
         std::cout << std::left
                   << std::setw(12) << process->name
@@ -140,36 +530,512 @@ void Scheduler::printScreen() {
     std::cout << "----------------------------------------\n";
 }
 
+// Per-domain load for screen -ls and report-util, when the cores are partitioned.
+// Caller holds coreMutex shared.
+void Scheduler::printDomains(std::ostream& out) {
+    if (domains.size() < 2) return;
+    out << "Scheduler domains: " << domains.size() << "\n";
+    for (auto& domain : domains) {
+        int busy = 0;
+        for (const CPUCore* core : domain.cores) {
+            if (core->currentProcess) busy++;
+        }
+        size_t ready;
+        {
+            TimedUniqueLock<std::mutex> queueLock(domain.queueMutex, domain.queueStats);
+            ready = domain.readyQueue->size();
+        }
+        out << "  Domain " << domain.id << ": " << busy << " / " << domain.cores.size() << " cores busy, "
+            << ready << " ready, balanced in " << domain.balancedIn << " / out " << domain.balancedOut << "\n";
+    }
+}
+
+// Parses the tickets config, e.g. "process*=100 p*=50 alice=300", into the rules new
+// processes get their tickets from. Processes already admitted keep theirs but are
+// regrouped under the new rules for the share report. On a bad spec the rules stay as
+// they were and false is returned.
+bool Scheduler::configureTickets(const std::string& spec) {
+    std::vector<TicketRule> rules;
+    std::istringstream in(spec);
+    std::string entry;
+    while (in >> entry) {
+        size_t eq = entry.find('=');
+        TicketRule rule;
+        rule.pattern = entry.substr(0, eq);
+        bool valid = eq != std::string::npos && eq > 0;
+        if (valid) {
+            std::istringstream count(entry.substr(eq + 1));
+            valid = (bool)(count >> rule.tickets) && count.eof() && rule.tickets >= 1 && rule.tickets <= kMaxTickets;
+        }
+        if (!valid) {
+            std::cout << "Invalid tickets entry '" << entry << "' (expected <name>=N or <prefix>*=N, N from 1 to "
+                      << kMaxTickets << ").\n";
+            return false;
+        }
+        rules.push_back(rule);
+    }
+    // No core may be charging while the share totals are rebuilt
+    TimedUniqueLock<std::shared_mutex> coreLock(coreMutex, coreExclusiveStats);
+    TimedUniqueLock<std::shared_mutex> lock(tableMutex, tableExclusiveStats);
+    ticketRules = std::move(rules);
+    rebuildTotals();
+    return true;
+}
+
+bool Scheduler::TicketRule::matches(const std::string& name) const {
+    if (!pattern.empty() && pattern.back() == '*') {
+        return name.compare(0, pattern.size() - 1, pattern, 0, pattern.size() - 1) == 0;
+    }
+    return name == pattern;
+}
+
+// First rule name matches, or nullptr. Caller holds tableMutex.
+const Scheduler::TicketRule* Scheduler::findTicketRule(const std::string& name) const {
+    for (const TicketRule& rule : ticketRules) {
+        if (rule.matches(name)) return &rule;
+    }
+    return nullptr;
+}
+
+// Under stride or lottery: for each ticket rule's class of unfinished processes, the
+// CPU share its tickets entitle it to against the share of ticks it has had. Processes
+// admitted under an older rule set are grouped by the current rules. Printed from the
+// running totals, so the cost does not grow with the process table.
+void Scheduler::printShares(std::ostream& out) {
+    if (!activePolicy || !activePolicy->ticketed) return;
+
+    struct ShareClass {
+        std::string label;
+        int processes = 0;
+        long long tickets = 0;
+        long long ticks = 0;
+    };
+    std::vector<ShareClass> classes;
+    long long totalTickets = 0, totalTicks = 0;
+    {
+        TimedSharedLock lock(tableMutex, tableSharedStats);
+        classes.resize(shareTotals.size());
+        for (size_t i = 0; i < classes.size(); i++) {
+            classes[i].label = i < ticketRules.size() ? ticketRules[i].pattern : "(other)";
+            classes[i].processes = shareTotals[i].processes;
+            classes[i].tickets = shareTotals[i].tickets;
+            classes[i].ticks = shareTotals[i].ticks;
+            totalTickets += classes[i].tickets;
+            totalTicks += classes[i].ticks;
+        }
+    }
+    if (totalTickets == 0) return;
+
+    out << "Shares (target / achieved):\n" << std::fixed << std::setprecision(1);
+    for (const ShareClass& shareClass : classes) {
+        if (shareClass.processes == 0) continue;
+        double target = 100.0 * shareClass.tickets / totalTickets;
+        double achieved = totalTicks > 0 ? 100.0 * shareClass.ticks / totalTicks : 0.0;
+        out << "  " << std::left << std::setw(12) << shareClass.label << std::right << " "
+            << shareClass.processes << " processes, " << shareClass.tickets << " tickets: "
+            << target << "% / " << achieved << "%\n";
+    }
+    out << std::defaultfloat << std::setprecision(6);
+}
+
+// Counts a newly admitted process in the share and deadline totals. Caller holds
+// tableMutex exclusive.
+void Scheduler::addToTotals(Process* process) {
+    const TicketRule* rule = findTicketRule(process->name);
+    process->shareClass = rule ? (int)(rule - ticketRules.data()) : (int)ticketRules.size();
+    ShareTotals& totals = shareTotals[process->shareClass];
+    totals.processes++;
+    totals.tickets += process->tickets;
+    totals.ticks += process->ticksRun;
+
+    if (process->deadlineMs <= 0) return;
+    auto due = process->creationTime + std::chrono::milliseconds(process->deadlineMs);
+    std::lock_guard<std::mutex> lock(completionMutex);
+    if (due <= overdueCutoff) {
+        overdueDeadlines++;
+    } else {
+        pendingDeadlines.insert(due);
+    }
+}
+
+// Takes a process that just finished out of the share and deadline totals
+void Scheduler::removeFromTotals(const Process* process) {
+    ShareTotals& totals = shareTotals[process->shareClass];
+    totals.processes--;
+    totals.tickets -= process->tickets;
+    totals.ticks -= process->ticksRun;
+
+    if (process->deadlineMs <= 0) return;
+    auto due = process->creationTime + std::chrono::milliseconds(process->deadlineMs);
+    std::lock_guard<std::mutex> lock(completionMutex);
+    if (due <= overdueCutoff) {
+        overdueDeadlines--;
+    } else {
+        auto pending = pendingDeadlines.find(due);
+        if (pending != pendingDeadlines.end()) pendingDeadlines.erase(pending);
+    }
+}
+
+// Recounts the totals from the table after the rules or the process set changed.
+// Caller holds coreMutex and tableMutex exclusive.
+void Scheduler::rebuildTotals() {
+    shareTotals = std::vector<ShareTotals>(ticketRules.size() + 1);
+    {
+        std::lock_guard<std::mutex> lock(completionMutex);
+        pendingDeadlines.clear();
+        overdueDeadlines = 0;
+    }
+    for (const auto& processPtr : allProcesses) {
+        if (!processPtr->finished()) addToTotals(processPtr.get());
+    }
+}
+
+// Starts, moves or stops the stats server to match stats-socket
+void Scheduler::configureStatsServer() {
+    const std::string& path = systemConfig.statsSocket;
+    if (path.empty()) {
+        statsServer.stop();
+        return;
+    }
+    if (statsServer.running() && statsServer.socketPath() == path) return;
+    if (!statsServer.start(path)) {
+        std::cout << "Failed to open stats socket " << path << ".\n";
+        return;
+    }
+    std::cout << "Stats: serving on " << path << "\n";
+    TimedSharedLock coreLock(coreMutex, coreSharedStats);
+    publishStats();
+}
+
+// Copies the counters, cores, queues and process list into a fresh snapshot for the
+// stats server. Runs once per scheduler tick, so stats clients never take a lock
+// themselves. Only the running processes and the first kStatsReadyListed of each ready
+// queue are listed, so the work (and the time swapMutex is held) stays bounded however
+// many processes exist. Caller holds coreMutex shared.
+void Scheduler::publishStats() {
+    auto stats = std::make_shared<StatsSnapshot>();
+    stats->timestampMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    stats->running = isRunning;
+    stats->scheduler = systemConfig.scheduler;
+    stats->quantumCycles = quantumCycles;
+    stats->cpuTicks = cpuTicks;
+    stats->utilization = calculateCPUUtilization();
+    stats->coresUsed = getActiveCores();
+    stats->contextSwitches = contextSwitchCount;
+    stats->switchCycles = switchCycleCount;
+    stats->migrations = migrationCount;
+    stats->warmupCycles = warmupCycleCount;
+    stats->retiredInstructions = retiredInstructions;
+    MemoryStats memoryStats = memory.stats();
+    stats->memoryTotal = memoryStats.total;
+    stats->memoryUsed = memoryStats.used;
+
+    std::vector<const Process*> listed;
+    for (auto& domain : domains) {
+        DomainSnapshot domainStats = {domain.id, (int)domain.cores.size(), 0, 0, domain.balancedIn, domain.balancedOut};
+        for (const CPUCore* core : domain.cores) {
+            const Process* process = core->currentProcess;
+            if (process) {
+                domainStats.busyCores++;
+                listed.push_back(process);
+            }
+            stats->cores.push_back({core->id, domain.id, core->draining, process ? process->id : -1, core->currentQuantum});
+        }
+        {
+            TimedUniqueLock<std::mutex> queueLock(domain.queueMutex, domain.queueStats);
+            domainStats.readyQueue = (long long)domain.readyQueue->size();
+            int left = kStatsReadyListed;
+            domain.readyQueue->visit([&](Process* process) {
+                listed.push_back(process);
+                return --left > 0;
+            });
+        }
+        stats->processesReady += domainStats.readyQueue;
+        stats->domains.push_back(domainStats);
+    }
+    std::sort(stats->cores.begin(), stats->cores.end(), [](const CoreSnapshot& a, const CoreSnapshot& b) {
+        return a.id < b.id;
+    });
+
+    stats->processesRunning = stats->coresUsed;
+    stats->processesFinished = std::max(0LL, (long long)processCount() - liveProcesses);
+
+    {
+        // The swap lock keeps images from being dropped while their line is read
+        std::lock_guard<std::mutex> swapLock(swapMutex);
+        stats->processesSwapped = swap.stats().images;
+        stats->processes.reserve(listed.size());
+        for (const Process* process : listed) {
+            bool swapped = process->swappedOut();
+            int line = process->finished() ? process->lineCount : swapped ? -1 : process->currentLine();
+            stats->processes.push_back({process->id, process->name,
+                                        process->state() == ProcessState::RUNNING ? "running" : "ready",
+                                        swapped, process->coreId(), line, process->lineCount});
+        }
+    }
+
+    statsServer.publish(std::move(stats));
+}
+
+// Opens, moves or closes the utilization log to match log-interval-ms and log-file
+void Scheduler::configureUtilizationLog() {
+    if (systemConfig.logIntervalMs <= 0 || systemConfig.logFile.empty()) {
+        utilLog.close();
+        return;
+    }
+    if (!utilLog.open(systemConfig.logFile, systemConfig.logMaxBytes, systemConfig.logMaxAgeS * 1000LL)) {
+        std::cout << "Failed to open utilization log " << systemConfig.logFile << ".\n";
+    }
+}
+
+// Appends a sample every log-interval-ms until the scheduler stops. A reload that
+// changes the interval (or turns logging on) restarts the wait.
+void Scheduler::utilizationLogLoop() {
+    std::unique_lock<std::mutex> wake(wakeMutex);
+    while (isRunning) {
+        int seenConfigVersion = configVersion;
+        auto interrupted = [&] { return !isRunning || configVersion != seenConfigVersion; };
+        if (systemConfig.logIntervalMs <= 0) {
+            schedulerCV.wait(wake, interrupted);
+            continue;
+        }
+        if (schedulerCV.wait_for(wake, std::chrono::milliseconds(systemConfig.logIntervalMs), interrupted)) continue;
+
+        wake.unlock();
+        logUtilization();
+        wake.lock();
+    }
+}
+
+// One sample costs a pass over the cores and domains plus the completions since the
+// last one, however many processes the table holds
+void Scheduler::logUtilization() {
+    if (!utilLog.isOpen()) return;
+
+    UtilizationSample sample;
+    {
+        TimedSharedLock coreLock(coreMutex, coreSharedStats);
+        sample.timeMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+        sample.tick = cpuTicks;
+        sample.utilization = calculateCPUUtilization();
+        sample.busyCores = getActiveCores();
+        sample.cores = (int)cores.size();
+        sample.readyProcesses = 0;
+        for (auto& domain : domains) {
+            TimedUniqueLock<std::mutex> queueLock(domain.queueMutex, domain.queueStats);
+            sample.readyProcesses += (long long)domain.readyQueue->size();
+        }
+        sample.retiredInstructions = retiredInstructions;
+        sample.contextSwitches = contextSwitchCount;
+    }
+
+    std::vector<CompletionRecord> finished;
+    {
+        std::lock_guard<std::mutex> lock(completionMutex);
+        finished.swap(completions);
+    }
+    utilLog.append(sample, finished);
+}
+
+// Queues a finished process for the next log sample
+void Scheduler::recordCompletion(const Process* process) {
+    if (systemConfig.logIntervalMs <= 0 || !utilLog.isOpen()) return;
+    CompletionRecord record;
+    record.timeMs = std::chrono::duration_cast<std::chrono::milliseconds>(process->finishTime.time_since_epoch()).count();
+    record.pid = process->id;
+    record.name = process->name;
+    record.lines = process->lineCount;
+    record.turnaroundMs = std::chrono::duration_cast<std::chrono::milliseconds>(process->finishTime - process->creationTime).count();
+    std::lock_guard<std::mutex> lock(completionMutex);
+    completions.push_back(record);
+}
+
+// Counts a finished process against its deadline, if it has one
+void Scheduler::recordDeadline(const Process* process) {
+    if (process->deadlineMs <= 0) return;
+    long long latenessMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+        process->finishTime - process->creationTime).count() - process->deadlineMs;
+    std::lock_guard<std::mutex> lock(completionMutex);
+    if (latenessMs <= 0) {
+        deadlineStats.met++;
+        return;
+    }
+    deadlineStats.missed++;
+    deadlineStats.latenessMsSum += latenessMs;
+    deadlineStats.latenessMsMax = std::max(deadlineStats.latenessMsMax, latenessMs);
+    int bucket = 0;
+    for (long long bound = 10; bucket < kLatenessBuckets - 1 && latenessMs > bound; bound *= 10) bucket++;
+    deadlineStats.missesByLateness[bucket]++;
+}
+
+// Deadline misses among finished processes, how late they were, and how many
+// unfinished processes are already past theirs. Nothing if no process had a deadline.
+void Scheduler::printDeadlines(std::ostream& out) {
+    DeadlineStats stats;
+    long long pending, overdue;
+    {
+        std::lock_guard<std::mutex> lock(completionMutex);
+        stats = deadlineStats;
+        // Due times only move one way, from pending to overdue
+        overdueCutoff = std::max(overdueCutoff, std::chrono::system_clock::now());
+        while (!pendingDeadlines.empty() && *pendingDeadlines.begin() <= overdueCutoff) {
+            pendingDeadlines.erase(pendingDeadlines.begin());
+            overdueDeadlines++;
+        }
+        overdue = overdueDeadlines;
+        pending = (long long)pendingDeadlines.size() + overdue;
+    }
+    long long finished = stats.met + stats.missed;
+    if (finished == 0 && pending == 0) return;
+
+    out << std::fixed << std::setprecision(1);
+    out << "Deadlines: " << stats.met << " met, " << stats.missed << " missed";
+    if (finished > 0) out << " (" << 100.0 * stats.missed / finished << "% of finished)";
+    out << "; " << pending << " unfinished, " << overdue << " of them past due\n";
+    if (stats.missed > 0) {
+        static const char* kBucketLabels[kLatenessBuckets] = {"<=10ms", "<=100ms", "<=1s", "<=10s", ">10s"};
+        out << "Lateness of misses: avg " << (double)stats.latenessMsSum / stats.missed << " ms, max "
+            << stats.latenessMsMax << " ms\n ";
+        for (int i = 0; i < kLatenessBuckets; i++) {
+            out << " " << kBucketLabels[i] << ": " << stats.missesByLateness[i];
+        }
+        out << "\n";
+    }
+    out << std::defaultfloat << std::setprecision(6);
+}
+
+// report-util while the utilization log is on: the history is summarised from the
+// log's segment index, so the report costs the same however many processes ran
+void Scheduler::reportUtilFromLog() {
+    std::ofstream report("csopesy-log.txt");
+    if (!report.is_open()) return;
+
+    auto formatTime = [](long long ms) {
+        std::time_t time = (std::time_t)(ms / 1000);
+        std::ostringstream out;
+        out << std::put_time(std::localtime(&time), "%m/%d/%Y %I:%M:%S %p");
+        return out.str();
+    };
+
+    std::vector<LogSegmentSummary> segments = utilLog.segments();
+    LogSegmentSummary total;
+    for (const auto& segment : segments) {
+        if (total.firstMs == 0 || (segment.firstMs > 0 && segment.firstMs < total.firstMs)) total.firstMs = segment.firstMs;
+        total.lastMs = std::max(total.lastMs, segment.lastMs);
+        total.samples += segment.samples;
+        total.utilizationSum += segment.utilizationSum;
+        total.utilizationPeak = std::max(total.utilizationPeak, segment.utilizationPeak);
+        total.completions += segment.completions;
+        total.turnaroundMsSum += segment.turnaroundMsSum;
+        total.retiredInstructions += segment.retiredInstructions;
+    }
+
+    report << "CPU Utilization Report\n";
+    {
+        TimedSharedLock coreLock(coreMutex, coreSharedStats);
+        report << "CPU utilization: " << calculateCPUUtilization() << "%\n";
+        report << "Cores used: " << getActiveCores() << "\n";
+        report << "Cores available: " << ((int)cores.size() - getActiveCores()) << "\n";
+        printShares(report);
+        printDeadlines(report);
+    }
+    report << "\nHistory from " << utilLog.path() << " (" << segments.size() << " segment(s))\n";
+    if (total.samples == 0) {
+        report << "No samples logged yet.\n";
+    } else {
+        double spanSeconds = (total.lastMs - total.firstMs) / 1000.0;
+        report << std::fixed << std::setprecision(1);
+        report << "Span: " << formatTime(total.firstMs) << " - " << formatTime(total.lastMs)
+               << " (" << spanSeconds << "s)\n";
+        report << "Samples: " << total.samples << "\n";
+        report << "Average CPU utilization: " << total.utilizationSum / total.samples << "%\n";
+        report << "Peak CPU utilization: " << total.utilizationPeak << "%\n";
+        report << "Processes finished: " << total.completions;
+        if (total.completions > 0) {
+            report << " (avg turnaround " << total.turnaroundMsSum / 1000.0 / total.completions << "s";
+            if (spanSeconds > 0) report << ", " << total.completions * 60.0 / spanSeconds << " per minute";
+            report << ")";
+        }
+        report << "\n";
+        report << "Instructions retired: " << total.retiredInstructions << "\n";
+
+        report << "\nSegments (seq: span, samples, avg utilization, finished):\n";
+        size_t first = segments.size() > kReportedSegments ? segments.size() - kReportedSegments : 0;
+        for (size_t i = first; i < segments.size(); i++) {
+            const LogSegmentSummary& segment = segments[i];
+            report << "  " << segment.seq << ": " << formatTime(segment.firstMs) << " - " << formatTime(segment.lastMs)
+                   << ", " << segment.samples << ", "
+                   << (segment.samples > 0 ? segment.utilizationSum / segment.samples : 0.0) << "%, "
+                   << segment.completions << "\n";
+        }
+    }
+    report.close();
+
+    std::filesystem::path filePath = std::filesystem::absolute("csopesy-log.txt");
+    std::cout << "Report generated at: " << filePath << "\n";
+}
+
 void Scheduler::reportUtil() {
-    std::lock_guard<std::mutex> lock(schedulerMutex);
-    
+    if (utilLog.isOpen()) {
+        reportUtilFromLog();
+        return;
+    }
     std::ofstream report("csopesy-log.txt");
     if (report.is_open()) {
+        TimedSharedLock coreLock(coreMutex, coreSharedStats);
         report << "CPU Utilization Report\n";
         report << "CPU utilization: " << calculateCPUUtilization() << "%\n";
         report << "Cores used: " << getActiveCores() << "\n";
-        report << "Cores available: " << (systemConfig.numCPU - getActiveCores()) << "\n\n";
+        report << "Cores available: " << ((int)cores.size() - getActiveCores()) << "\n";
+        report << "Migrations: " << migrationCount << " (" << warmupCycleCount << " warm-up cycles)\n";
+        report << "Context switches: " << contextSwitchCount << " (" << switchCycleCount << " overhead cycles)\n";
+        report << "Instructions retired: " << retiredInstructions << "\n";
+        printDomains(report);
+        printShares(report);
+        printDeadlines(report);
+        report << "Quantum cycles: " << quantumCycles
+               << (systemConfig.quantumAutotune ? " (auto-tuned)" : "") << "\n";
+        std::deque<QuantumSample> history;
+        {
+            std::lock_guard<std::mutex> lock(historyMutex);
+            history = quantumHistory;
+        }
+        if (!history.empty()) {
+            report << "Quantum history (tick: quantum, switch overhead, avg wait ticks):\n";
+            for (const auto& sample : history) {
+                report << "  " << sample.tick << ": " << sample.quantum << ", "
+                       << std::fixed << std::setprecision(3) << sample.switchOverhead << ", "
+                       << std::setprecision(1) << sample.avgWaitTicks << "\n";
+            }
+            report << std::defaultfloat << std::setprecision(6);
+        }
+        report << "\n";
         
         report << "Running processes:\n";
         for (const auto& core : cores) {
-            if (core.currentProcess) {
-                auto process = core.currentProcess;
+            Process* process = core.currentProcess;
+            if (process) {
                 auto currentTime = std::chrono::system_clock::now();
                 auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
                     currentTime - process->creationTime).count();
                 report << process->name << "   " 
                       << " (" << elapsed/1000.0 << "s)   " << "Core: " << core.id 
-                      << "   " << process->currentInstruction << " / " << process->instructions.size() << "\n";
+                      << "   " << process->currentLine() << " / " << process->lineCount << "\n";
             }
         }
         
+        coreLock.unlock();
+        
         report << "\nFinished processes:\n";
 
         std::vector<const Process*> finishedProcesses;
-        for (const auto& processPtr : allProcesses) {
-            if (processPtr->isFinished) {
-                finishedProcesses.push_back(processPtr.get());
-            }
+        {
+            TimedSharedLock lock(tableMutex, tableSharedStats);
+            allProcesses.forEachFinished([&](const Process* process) {
+                finishedProcesses.push_back(process);
+            });
         }
 
         std::sort(finishedProcesses.begin(), finishedProcesses.end(), [](const Process* a, const Process* b) {
@@ -187,7 +1053,7 @@ void Scheduler::reportUtil() {
                    << std::setw(12) << process->name
                    << std::setw(28) << timeStream.str()
                    << std::setw(12) << "Finished"
-                   << std::setw(10) << (std::to_string(process->instructions.size()) + " / " + std::to_string(process->instructions.size()))
+                   << std::setw(10) << (std::to_string(process->lineCount) + " / " + std::to_string(process->lineCount))
                    << "\n";
         }
         
@@ -198,207 +1064,1071 @@ void Scheduler::reportUtil() {
     }
 }
 
-Process* Scheduler::getProcess(const std::string& processName) {
-    std::lock_guard<std::mutex> lock(schedulerMutex);
-    
-    for (auto& processPtr : allProcesses) {
-        if (processPtr->name == processName) {
-            return processPtr.get();
+// Prints acquisition counts and wait/hold times for each scheduler lock, so contention
+// between the scheduling loop, arrivals and the CLI can be measured. reset zeroes them.
+void Scheduler::lockStats(bool reset) {
+    std::vector<LockStats*> all = {&coreSharedStats, &coreExclusiveStats, &tableSharedStats, &tableExclusiveStats};
+    for (auto& domain : domains) {
+        all.push_back(&domain.queueStats);
+    }
+    if (reset) {
+        for (LockStats* stats : all) stats->reset();
+        std::cout << "Lock statistics reset.\n";
+        return;
+    }
+
+    std::cout << std::left << std::setw(28) << "Lock" << std::right
+              << std::setw(12) << "Acquired" << std::setw(14) << "Avg wait us"
+              << std::setw(14) << "Avg hold us" << std::setw(14) << "Max hold us" << "\n";
+    std::cout << std::fixed << std::setprecision(2);
+    for (const LockStats* stats : all) {
+        long long acquisitions = stats->acquisitions;
+        double count = acquisitions ? (double)acquisitions : 1.0;
+        std::cout << std::left << std::setw(28) << stats->name << std::right
+                  << std::setw(12) << acquisitions
+                  << std::setw(14) << stats->waitNs / count / 1000.0
+                  << std::setw(14) << stats->holdNs / count / 1000.0
+                  << std::setw(14) << stats->maxHoldNs / 1000.0 << "\n";
+    }
+    std::cout << std::defaultfloat << std::setprecision(6) << std::left;
+}
+
+// Prints the simulated memory: occupancy, how fragmented the free space is, and what
+// placing processes has cost so far; then the swap file's contents and traffic.
+void Scheduler::vmstat() {
+    if (memory.enabled()) {
+        printMemoryStats();
+    } else {
+        std::cout << "Memory simulation is off (max-overall-mem is 0).\n";
+    }
+
+    SwapStats swapStats;
+    {
+        std::lock_guard<std::mutex> swapLock(swapMutex);
+        if (!swap.isOpen()) {
+            std::cout << "Swapping is off (swap-threshold-ms is 0).\n";
+            return;
         }
+        swapStats = swap.stats();
     }
-    return nullptr;
+    double outs = swapStats.swapOuts ? (double)swapStats.swapOuts : 1.0;
+    double ins = swapStats.swapIns ? (double)swapStats.swapIns : 1.0;
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "Swapped-out processes:  " << swapStats.images << " (" << swapStats.imageBytes << " bytes, file "
+              << swapStats.fileBytes << " bytes)\n";
+    std::cout << "Swap outs:              " << swapStats.swapOuts << " (avg " << swapStats.swapOutNs / outs / 1000.0
+              << " us, max " << swapStats.maxSwapOutNs / 1000.0 << " us)\n";
+    std::cout << "Swap ins:               " << swapStats.swapIns << " (avg " << swapStats.swapInNs / ins / 1000.0
+              << " us, max " << swapStats.maxSwapInNs / 1000.0 << " us)\n";
+    std::cout << std::defaultfloat << std::setprecision(6);
 }
 
-void Scheduler::schedulingLoop() {
-    while (isRunning) {
-        std::this_thread::sleep_for(std::chrono::milliseconds(100));
-        cpuTicks++;
-        
-        std::lock_guard<std::mutex> lock(schedulerMutex);
-        
-        // Check for finished processes and free cores
-        for (auto& core : cores) {
-            if (core.currentProcess && core.currentProcess->isFinished) {
-                core.currentProcess = nullptr;
-                core.isRunning = false;
-                core.currentQuantum = 0;
+void Scheduler::printMemoryStats() {
+    MemoryStats stats = memory.stats();
+    double allocations = stats.allocations + stats.failedAllocations;
+    double count = allocations > 0 ? allocations : 1.0;
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "Allocator:              " << stats.strategy << "\n";
+    std::cout << "Total memory:           " << stats.total << " bytes\n";
+    std::cout << "Used memory:            " << stats.used << " bytes ("
+              << (stats.total ? 100.0 * stats.used / stats.total : 0.0) << "%)\n";
+    std::cout << "Free memory:            " << stats.free << " bytes\n";
+    std::cout << "Resident processes:     " << stats.resident << "\n";
+    std::cout << "Largest free block:     " << stats.largestFree << " bytes\n";
+    std::cout << "External fragmentation: " << 100.0 * stats.externalFragmentation() << "%\n";
+    std::cout << "Internal waste:         " << stats.internalWaste << " bytes\n";
+    std::cout << "Allocations:            " << stats.allocations << " (" << stats.failedAllocations << " failed)\n";
+    std::cout << "Avg allocation time:    " << stats.allocationNs / count / 1000.0 << " us\n";
+    std::cout << "Max allocation time:    " << stats.maxAllocationNs / 1000.0 << " us\n";
+    std::cout << "Evictions:              " << stats.evictions << "\n";
+    std::cout << "Deferred dispatches:    " << stats.deferrals << "\n";
+    std::cout << std::defaultfloat << std::setprecision(6);
+}
+
+// Writes the complete scheduler state (processes, ready queue order, core assignments
+// and counters) to filename as a versioned binary image. The core set is held exclusively
+// for the snapshot, which pauses the scheduling loop between ticks, so it is consistent
+// even while the scheduler is running.
+bool Scheduler::checkpoint(const std::string& filename) {
+    BinaryWriter out;
+    size_t processCount;
+    {
+        TimedUniqueLock<std::shared_mutex> coreLock(coreMutex, coreExclusiveStats);
+        TimedSharedLock tableLock(tableMutex, tableSharedStats);
+        std::deque<TimedUniqueLock<std::mutex>> queueLocks;
+        for (auto& domain : domains) {
+            queueLocks.emplace_back(domain.queueMutex, domain.queueStats);
+        }
+
+        out.write<int32_t>(cpuTicks);
+        out.write<int64_t>(migrationCount);
+        out.write<int64_t>(warmupCycleCount);
+        out.write<int64_t>(contextSwitchCount);
+        out.write<int64_t>(switchCycleCount);
+
+        processCount = allProcesses.size();
+        out.write<uint32_t>((uint32_t)processCount);
+        std::lock_guard<std::mutex> swapLock(swapMutex);
+        for (const auto& processPtr : allProcesses) {
+            Process* process = processPtr.get();
+            if (process->swappedOut()) {
+                // Read back just for the snapshot; the image stays in the swap file
+                bool loaded = loadImage(process);
+                process->serialize(out);
+                process->dropImage();
+                if (!loaded) {
+                    std::cout << "Failed to read " << process->name << " back from the swap file.\n";
+                    return false;
+                }
+            } else {
+                process->serialize(out);
             }
         }
-        
-        // Round-robin scheduling
-        if (systemConfig.scheduler == "rr") {
-            roundRobinSchedule();
+
+        // The domains' queues are saved as one; restore deals them out again
+        size_t queued = 0;
+        for (const auto& domain : domains) {
+            queued += domain.readyQueue->size();
         }
-        // First Come First Serve scheduling
-        else if (systemConfig.scheduler == "fcfs") {
-            fcfsSchedule();
+        out.write<uint32_t>((uint32_t)queued);
+        for (const auto& domain : domains) {
+            domain.readyQueue->visit([&](Process* process) {
+                out.write<int32_t>(process->id);
+                return true;
+            });
         }
-        
-        // Execute instructions on running cores
-        for (auto& core : cores) {
-            if (core.currentProcess) {
-                executeInstruction(core);
-            }
+
+        out.write<uint32_t>((uint32_t)cores.size());
+        for (const auto& core : cores) {
+            const Process* process = core.currentProcess;
+            out.write<int32_t>(process ? process->id : -1);
+            out.write<int32_t>(core.currentQuantum);
+            out.write<int32_t>(core.switchCycles);
+            out.write<int32_t>(core.warmupCycles);
         }
-        
-        // Check if all processes are finished
-        if (!allProcessesFinishedMessageShown && !allProcesses.empty()) {
-            bool allFinished = true;
-            bool hasRunningProcesses = false;
-            
-            // Check if any process is still running or in ready queue
-            for (const auto& processPtr : allProcesses) {
-                const Process& process = *processPtr;
-                if (!process.isFinished) {
-                    allFinished = false;
-                    break;
+    }
+
+    std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+        std::cout << "Failed to open " << filename << " for writing.\n";
+        return false;
+    }
+
+    std::string image = out.finish();
+    file.write(kCheckpointMagic, sizeof(kCheckpointMagic));
+    file.write(reinterpret_cast<const char*>(&kCheckpointVersion), sizeof(kCheckpointVersion));
+    file.write(reinterpret_cast<const char*>(&kByteOrderMark), sizeof(kByteOrderMark));
+    file.write(image.data(), image.size());
+    if (!file) {
+        std::cout << "Failed to write checkpoint " << filename << ".\n";
+        return false;
+    }
+
+    std::cout << "Checkpoint of " << processCount << " processes written to " << filename
+              << " (" << (image.size() + 12) << " bytes).\n";
+    return true;
+}
+
+// Replaces the scheduler state with the image in filename. The whole file is read in
+// one go and parsed in place. Processes that were on a core the current configuration
+// no longer has go back to the front of the ready queue.
+bool Scheduler::restore(const std::string& filename) {
+    if (isRunning) {
+        std::cout << "Stop the scheduler before restoring a checkpoint.\n";
+        return false;
+    }
+
+    std::ifstream file(filename, std::ios::binary | std::ios::ate);
+    if (!file.is_open()) {
+        std::cout << "Failed to open " << filename << ".\n";
+        return false;
+    }
+    std::string image((size_t)file.tellg(), '\0');
+    file.seekg(0);
+    file.read(&image[0], image.size());
+
+    const size_t headerSize = sizeof(kCheckpointMagic) + sizeof(kCheckpointVersion) + sizeof(kByteOrderMark);
+    uint32_t version = 0, byteOrder = 0;
+    if (image.size() >= headerSize) {
+        std::memcpy(&version, image.data() + 4, sizeof(version));
+        std::memcpy(&byteOrder, image.data() + 8, sizeof(byteOrder));
+    }
+    if (image.size() < headerSize || image.compare(0, 4, kCheckpointMagic, 4) != 0) {
+        std::cout << filename << " is not a checkpoint file.\n";
+        return false;
+    }
+    if (version != kCheckpointVersion || byteOrder != kByteOrderMark) {
+        std::cout << filename << " was written by an incompatible version (format " << version << ").\n";
+        return false;
+    }
+
+    BinaryReader in(image.data() + headerSize, image.size() - headerSize);
+    in.readStringTable();
+
+    int newCpuTicks = in.read<int32_t>();
+    long long newMigrations = in.read<int64_t>();
+    long long newWarmupCycles = in.read<int64_t>();
+    long long newContextSwitches = in.read<int64_t>();
+    long long newSwitchCycles = in.read<int64_t>();
+
+    // Processes were written in pid order, so they land at the same pids
+    ProcessTable processes;
+    uint32_t processCount = in.read<uint32_t>();
+    for (uint32_t i = 0; i < processCount && in.good(); i++) {
+        if (!Process::deserialize(in, processes)) {
+            std::cout << filename << " is truncated or corrupt.\n";
+            return false;
+        }
+    }
+    auto byId = [&](int pid) -> Process* {
+        return pid >= 0 && pid < (int)processes.size() ? processes[pid] : nullptr;
+    };
+    // A process may be queued or on a core, not both and only once. Only unfinished
+    // ones are queued; a core can still hold one that finished in its last burst.
+    std::vector<uint8_t> placed(processes.size());
+    bool consistent = true;
+    auto place = [&](Process* process, bool queued) {
+        if (!process) return;
+        if ((queued && process->finished()) || placed[process->id]) consistent = false;
+        placed[process->id] = 1;
+    };
+
+    std::deque<Process*> queue;
+    uint32_t queueLength = in.read<uint32_t>();
+    for (uint32_t i = 0; i < queueLength && in.good(); i++) {
+        if (Process* process = byId(in.read<int32_t>())) {
+            place(process, true);
+            queue.push_back(process);
+        }
+    }
+
+    struct SavedCore { Process* process; int quantum, switchCycles, warmupCycles; };
+    std::vector<SavedCore> savedCores;
+    uint32_t coreCount = in.read<uint32_t>();
+    for (uint32_t i = 0; i < coreCount && in.good(); i++) {
+        SavedCore saved;
+        saved.process = byId(in.read<int32_t>());
+        saved.quantum = in.read<int32_t>();
+        saved.switchCycles = in.read<int32_t>();
+        saved.warmupCycles = in.read<int32_t>();
+        place(saved.process, false);
+        savedCores.push_back(saved);
+    }
+
+    if (!in.good() || !consistent) {
+        std::cout << filename << " is truncated or corrupt.\n";
+        return false;
+    }
+
+    TimedUniqueLock<std::shared_mutex> coreLock(coreMutex, coreExclusiveStats);
+    TimedUniqueLock<std::shared_mutex> tableLock(tableMutex, tableExclusiveStats);
+    std::deque<TimedUniqueLock<std::mutex>> queueLocks;
+    for (auto& domain : domains) {
+        queueLocks.emplace_back(domain.queueMutex, domain.queueStats);
+    }
+    allProcesses.takeFrom(processes);
+    processIndex.clear();
+    for (const auto& processPtr : allProcesses) {
+        processIndex.emplace(processPtr->name, processPtr.get());
+    }
+    for (auto& domain : domains) {
+        domain.readyQueue->clear();
+    }
+    for (Process* process : queue) {
+        domains[process->id % domains.size()].readyQueue->push(process);
+    }
+    cpuTicks = newCpuTicks;
+    migrationCount = newMigrations;
+    warmupCycleCount = newWarmupCycles;
+    contextSwitchCount = newContextSwitches;
+    switchCycleCount = newSwitchCycles;
+    allProcessesFinishedMessageShown = false;
+    liveProcesses = (long long)(allProcesses.size() - allProcesses.countFinished());
+    rebuildTotals();
+    // Addresses are not part of the image: start from an empty memory and place the
+    // processes that were running again, the rest are placed when next dispatched
+    memory.configure(systemConfig.memAllocator, systemConfig.maxOverallMem);
+    {
+        // The old processes' swap images went with them
+        std::lock_guard<std::mutex> swapLock(swapMutex);
+        for (auto& domain : domains) {
+            domain.swapQueue.clear();
+        }
+        if (swap.isOpen() && !swap.open(systemConfig.swapFile)) {
+            std::cout << "Failed to recreate swap file " << systemConfig.swapFile << "; swapping is off.\n";
+        }
+    }
+
+    for (auto& core : cores) {
+        core.currentProcess = nullptr;
+        core.isRunning = false;
+        core.currentQuantum = 0;
+        core.switchCycles = 0;
+        core.warmupCycles = 0;
+    }
+    for (size_t i = savedCores.size(); i-- > 0;) {
+        Process* process = savedCores[i].process;
+        if (!process) continue;
+        SchedulerDomain& domain = domains[(i < cores.size() ? i : process->id) % domains.size()];
+        if (i < cores.size() && !cores[i].draining && makeResident(domain, process)) {
+            CPUCore& core = cores[i];
+            core.currentProcess = process;
+            core.isRunning = true;
+            core.currentQuantum = savedCores[i].quantum;
+            core.switchCycles = savedCores[i].switchCycles;
+            core.warmupCycles = savedCores[i].warmupCycles;
+        } else {
+            process->state() = ProcessState::READY;
+            domain.readyQueue->pushFront(process);
+        }
+    }
+    for (auto& domain : domains) {
+        domain.readyQueue->visit([&](Process* process) {
+            queueSwapCandidate(domain, process);
+            return true;
+        });
+    }
+    allProcesses.forEachFinished([&](Process* process) {
+        queueSwapCandidate(domains[process->id % domains.size()], process);
+    });
+    assignCoresToDomains(); // the cores' masks follow what was put back on them
+
+    std::cout << "Restored " << allProcesses.size() << " processes from " << filename << ".\n";
+    return true;
+}
+
+Process* Scheduler::getProcess(const std::string& processName) {
+    TimedSharedLock lock(tableMutex, tableSharedStats);
+    
+    auto it = processIndex.find(processName);
+    return it != processIndex.end() ? it->second : nullptr;
+}
+
+Process* Scheduler::pinProcess(const std::string& processName) {
+    Process* process = getProcess(processName);
+    if (!process) return nullptr;
+
+    std::lock_guard<std::mutex> swapLock(swapMutex);
+    if (process->swappedOut()) swapIn(process);
+    process->pins++;
+    return process;
+}
+
+void Scheduler::unpinProcess(Process* process) {
+    if (!process) return;
+    std::lock_guard<std::mutex> swapLock(swapMutex);
+    process->pins--;
+}
+
+size_t Scheduler::processCount() {
+    TimedSharedLock lock(tableMutex, tableSharedStats);
+    return allProcesses.size();
+}
+
+template <typename Policy>
+Scheduler::PolicyEntry Scheduler::policyEntry() {
+    return {Policy::kName, &Scheduler::schedulingLoop<Policy>,
+            [] { return std::unique_ptr<RunQueue>(new typename Policy::Queue()); }, Policy::kTicketed};
+}
+
+// The policies the scheduler key can name
+const std::vector<Scheduler::PolicyEntry>& Scheduler::policies() {
+    static const std::vector<PolicyEntry> entries = {
+        policyEntry<FcfsPolicy>(),
+        policyEntry<RoundRobinPolicy>(),
+        policyEntry<CfsPolicy>(),
+        policyEntry<StridePolicy>(),
+        policyEntry<LotteryPolicy>(),
+        policyEntry<EdfPolicy>(),
+        policyEntry<EdfRoundRobinPolicy>(),
+    };
+    return entries;
+}
+
+const Scheduler::PolicyEntry* Scheduler::findPolicy(const std::string& name) {
+    for (const PolicyEntry& policy : policies()) {
+        if (name == policy.name) return &policy;
+    }
+    return nullptr;
+}
+
+// Every registered policy name in registry order, for messages: comma-separated with
+// "or" before the last
+std::string Scheduler::policyNames() {
+    const std::vector<PolicyEntry>& entries = policies();
+    std::string names;
+    for (size_t i = 0; i < entries.size(); i++) {
+        if (i > 0) names += i + 1 == entries.size() ? " or " : ", ";
+        names += entries[i].name;
+    }
+    return names;
+}
+
+// One domain's scheduling loop, compiled for its policy. The queue is the policy's
+// own type, so dispatch calls it directly.
+template <typename Policy>
+void Scheduler::schedulingLoop(SchedulerDomain& domain) {
+    typename Policy::Queue& queue = static_cast<typename Policy::Queue&>(*domain.readyQueue);
+    const auto tickInterval = std::chrono::milliseconds(100);
+    auto nextTick = std::chrono::steady_clock::now();
+
+    while (isRunning) {
+        bool hasWork = false;
+        bool hasSleepers = false;
+        bool idleDrainedCore = false;
+        auto earliestWake = std::chrono::steady_clock::time_point::max();
+        {
+            // Shared is enough: only this thread writes its domain's per-core state, and
+            // the hold keeps reload, checkpoint and restore out until the tick is done
+            TimedSharedLock coreLock(coreMutex, coreSharedStats);
+
+            releaseFinishedCores(domain);
+
+            auto now = std::chrono::steady_clock::now();
+            if (now >= nextTick) {
+                bool clockTicked = advanceClock(now);
+
+                schedule<Policy>(domain);
+
+                // Execute instructions on running cores
+                executeCores<Policy>(domain);
+
+                if (Policy::kTimeSliced && clockTicked && systemConfig.quantumAutotune &&
+                    cpuTicks % std::max(1, systemConfig.autotuneInterval) == 0) {
+                    autotuneQuantum();
+                }
+                if (clockTicked && statsServer.running()) {
+                    publishStats();
                 }
+
+                swapOutIdle(domain);
+
+                nextTick = now + tickInterval;
+            } else {
+                // Woken between ticks by an arrival: hand it to an idle core right away.
+                // Quantum accounting still only advances on ticks.
+                TimedUniqueLock<std::mutex> queueLock(domain.queueMutex, domain.queueStats);
+                fillIdleCores(domain, queue);
             }
-            
-            // Check if any core has a running process
-            for (const auto& core : cores) {
-                if (core.currentProcess) {
-                    hasRunningProcesses = true;
-                    break;
+
+            bool readyQueueEmpty;
+            {
+                TimedUniqueLock<std::mutex> queueLock(domain.queueMutex, domain.queueStats);
+                readyQueueEmpty = queue.empty();
+            }
+
+            // Decide how long to block: tick while something can execute, sleep until the
+            // earliest SLEEP expiry if every resident process is asleep, otherwise wait
+            // for an arrival or stop.
+            now = std::chrono::steady_clock::now();
+            hasWork = !readyQueueEmpty;
+            bool hasRunningProcesses = domain.busyCores.any();
+            domain.busyCores.forEach([&](int slot) {
+                const Process* process = domain.cores[slot]->currentProcess;
+                if (process->sleepUntil > now) {
+                    hasSleepers = true;
+                    earliestWake = std::min(earliestWake, process->sleepUntil);
+                } else {
+                    hasWork = true;
                 }
+            });
+
+            // Only a domain that has run dry looks at whether the others have too
+            if (!allProcessesFinishedMessageShown && !hasRunningProcesses && readyQueueEmpty) {
+                checkAllFinished();
             }
-            
-            // Check if ready queue is empty
-            bool readyQueueEmpty = readyQueue.empty();
-            
-            if (allFinished && !hasRunningProcesses && readyQueueEmpty) {
-                std::cout << "\n=== All processes have finished execution ===\n";
-                std::cout << "Scheduler is still running. Use 'screen -ls' to view process summary.\n";
-                std::cout << "Type 'scheduler-stop' to stop the scheduler or 'exit' to quit.\n\n>";
-                allProcessesFinishedMessageShown = true;
+
+            {
+                // Wake up for the next swap-out even with nothing to execute
+                std::lock_guard<std::mutex> swapLock(swapMutex);
+                if (!domain.swapQueue.empty() && systemConfig.swapThresholdMs > 0) {
+                    hasSleepers = true;
+                    earliestWake = std::min(earliestWake, domain.swapQueue.front().since +
+                                            std::chrono::milliseconds(systemConfig.swapThresholdMs));
+                }
             }
+            idleDrainedCore = !cores.empty() && cores.back().draining && !cores.back().currentProcess;
+        }
+
+        if (idleDrainedCore) {
+            TimedUniqueLock<std::shared_mutex> coreLock(coreMutex, coreExclusiveStats);
+            removeDrainedCores();
         }
+
+        std::unique_lock<std::mutex> wake(wakeMutex);
+        auto woken = [&] { return domain.wakePending || !isRunning; };
+        if (hasWork) {
+            schedulerCV.wait_until(wake, nextTick, woken);
+        } else if (hasSleepers) {
+            schedulerCV.wait_until(wake, std::max(earliestWake, nextTick), woken);
+        } else {
+            schedulerCV.wait(wake, woken);
+        }
+        domain.wakePending = false;
     }
 }
 
-void Scheduler::roundRobinSchedule() {
-    for (auto& core : cores) {
-        if (!core.currentProcess && !readyQueue.empty()) {
-            // Assign new process to core
-            core.currentProcess = readyQueue.front();
-            readyQueue.pop();
-            core.currentProcess->state = ProcessState::RUNNING;
-            core.currentProcess->coreId = core.id;
-            core.isRunning = true;
-            core.currentQuantum = 0;
-        } else if (core.currentProcess && core.currentQuantum >= systemConfig.quantumCycles) {
-            // Time slice expired, preempt process
-            if (!core.currentProcess->isFinished) {
-                core.currentProcess->state = ProcessState::READY;
-                readyQueue.push(core.currentProcess);
-            }
-            core.currentProcess = nullptr;
-            core.isRunning = false;
-            core.currentQuantum = 0;
-            
-            // Assign new process if available
-            if (!readyQueue.empty()) {
-                core.currentProcess = readyQueue.front();
-                readyQueue.pop();
-                core.currentProcess->state = ProcessState::RUNNING;
-                core.currentProcess->coreId = core.id;
-                core.isRunning = true;
+// Advances cpuTicks unless another domain already has in the current tick period.
+// Returns whether this call did.
+bool Scheduler::advanceClock(std::chrono::steady_clock::time_point now) {
+    long long nowNs = std::chrono::duration_cast<std::chrono::nanoseconds>(now.time_since_epoch()).count();
+    long long due = nextClockTick;
+    if (nowNs < due || !nextClockTick.compare_exchange_strong(due, nowNs + 100000000LL)) {
+        return false;
+    }
+    cpuTicks++;
+    return true;
+}
+
+// Announces, once, that every process has finished. Arrivals count themselves live
+// before they are queued, so a zero count means nothing is queued or left to run.
+void Scheduler::checkAllFinished() {
+    if (liveProcesses > 0 || processCount() == 0) return;
+
+    if (!allProcessesFinishedMessageShown.exchange(true)) {
+        console.notice("=== All processes have finished execution ===\n"
+                       "Scheduler is still running. Use 'screen -ls' to view process summary.\n"
+                       "Type 'scheduler-stop' to stop the scheduler or 'exit' to quit.");
+    }
+}
+
+// Every kBalanceIntervalMs, evens out the domains' ready queues until the scheduler stops
+void Scheduler::balanceLoop() {
+    std::unique_lock<std::mutex> wake(wakeMutex);
+    while (isRunning) {
+        schedulerCV.wait_for(wake, std::chrono::milliseconds(kBalanceIntervalMs), [this] { return !isRunning; });
+        if (!isRunning) break;
+        wake.unlock();
+        balanceDomains();
+        wake.lock();
+    }
+}
+
+// Moves ready processes from the longest queue to the shortest until no two differ by
+// more than one. A domain left without cores by a reload hands over its whole queue.
+// Processes are taken from the back of the source queue, the ones that would have
+// waited longest there, and join the back of the target's.
+void Scheduler::balanceDomains() {
+    TimedSharedLock coreLock(coreMutex, coreSharedStats);
+    std::vector<size_t> lengths;
+    for (auto& domain : domains) {
+        TimedUniqueLock<std::mutex> queueLock(domain.queueMutex, domain.queueStats);
+        lengths.push_back(domain.readyQueue->size());
+    }
+
+    for (size_t round = 0; round < domains.size(); round++) {
+        // A coreless domain counts as infinitely loaded and can never be the target
+        auto load = [&](size_t i) {
+            return domains[i].cores.empty() && lengths[i] > 0 ? SIZE_MAX : lengths[i];
+        };
+        size_t busiest = 0, idlest = SIZE_MAX;
+        for (size_t i = 0; i < domains.size(); i++) {
+            if (load(i) > load(busiest)) busiest = i;
+            if (!domains[i].cores.empty() && (idlest == SIZE_MAX || lengths[i] < lengths[idlest])) idlest = i;
+        }
+        if (idlest == SIZE_MAX || busiest == idlest) return;
+        size_t moves = load(busiest) == SIZE_MAX ? lengths[busiest] : (lengths[busiest] - lengths[idlest]) / 2;
+        if (moves == 0) return;
+
+        SchedulerDomain& from = domains[busiest];
+        SchedulerDomain& to = domains[idlest];
+        {
+            // Queue locks are taken in domain order
+            SchedulerDomain& first = from.id < to.id ? from : to;
+            SchedulerDomain& second = from.id < to.id ? to : from;
+            TimedUniqueLock<std::mutex> firstLock(first.queueMutex, first.queueStats);
+            TimedUniqueLock<std::mutex> secondLock(second.queueMutex, second.queueStats);
+            moves = std::min(moves, from.readyQueue->size()); // it may have been dispatched from since
+            for (size_t i = 0; i < moves; i++) {
+                Process* process = from.readyQueue->popBack();
+                to.readyQueue->push(process);
+                queueSwapCandidate(to, process);
             }
+            lengths[busiest] = from.readyQueue->size();
+            lengths[idlest] = to.readyQueue->size();
         }
-        
-        if (core.currentProcess) {
-            core.currentQuantum++;
+        from.balancedOut += moves;
+        to.balancedIn += moves;
+
+        {
+            std::lock_guard<std::mutex> wake(wakeMutex);
+            to.wakePending = true;
         }
+        schedulerCV.notify_all();
     }
 }
 
-void Scheduler::fcfsSchedule(){
-    for(auto &core : cores){
-        if(!core.currentProcess && !readyQueue.empty()){
-            Process* nextProc = readyQueue.front();
-            readyQueue.pop();
+// A tick's scheduling decisions: preempt where the policy slices time, then refill
+// the idle cores, then let waiting processes take cores from ones they outrank
+template <typename Policy>
+void Scheduler::schedule(SchedulerDomain& domain) {
+    TimedUniqueLock<std::mutex> queueLock(domain.queueMutex, domain.queueStats);
+    if constexpr (Policy::kTimeSliced) {
+        preemptExpired<Policy>(domain);
+    } else {
+        domain.expiredCores.clear(); // listed by a restore; nothing is sliced
+    }
+    fillIdleCores(domain, static_cast<typename Policy::Queue&>(*domain.readyQueue));
+    if constexpr (Policy::kPreemptive) {
+        preemptOutranked<Policy>(domain);
+    }
+}
 
-            nextProc->state = ProcessState::RUNNING;
-            nextProc->coreId = core.id;
+// Puts the processes whose time slice expired in the last burst, and that the policy says
+// should give way, back in the ready queue. Quantum counting happens in executeCores().
+template <typename Policy>
+void Scheduler::preemptExpired(SchedulerDomain& domain) {
+    typename Policy::Queue& queue = static_cast<typename Policy::Queue&>(*domain.readyQueue);
+    for (int slot : domain.expiredCores) {
+        CPUCore& core = *domain.cores[slot];
+        Process* running = core.currentProcess;
+        // The quantum may have been raised since the slot was listed
+        if (!running || running->finished() || core.currentQuantum < quantumCycles) continue;
+        if (!Policy::preempts(queue, running)) {
+            core.currentQuantum = 0; // nobody is owed the core yet; start another slice
+            continue;
+        }
+        requeue(domain, core);
+    }
+    domain.expiredCores.clear();
+}
 
-            core.currentProcess = nextProc;
-            core.isRunning = true;
-            //No quantum bookkeeping needed for FCFS
+// While the head of the ready queue outranks the lowest-ranked running process, the
+// head takes that process's core and the process goes back to the queue. Runs once the
+// idle cores are filled, so a preemption only happens when no core is free. Draining
+// cores are left to finish. Caller holds the domain's queueMutex.
+template <typename Policy>
+void Scheduler::preemptOutranked(SchedulerDomain& domain) {
+    typename Policy::Queue& queue = static_cast<typename Policy::Queue&>(*domain.readyQueue);
+    while (!queue.empty() && !domain.idleCores.any()) {
+        CPUCore* lowest = nullptr;
+        domain.busyCores.forEach([&](int slot) {
+            CPUCore& core = *domain.cores[slot];
+            Process* running = core.currentProcess;
+            if (core.draining || !running || running->finished()) return;
+            if (!lowest || Policy::outranks(lowest->currentProcess, running)) lowest = &core;
+        });
+        queue.beginDispatch();
+        Process* next = queue.front();
+        if (!lowest || !Policy::outranks(next, lowest->currentProcess)) break;
+        if (!makeResident(domain, next)) {
+            memory.recordDeferral();
+            break;
         }
+        queue.remove(next);
+        requeue(domain, *lowest);
+        dispatch(domain, *lowest, next);
     }
 }
 
-void Scheduler::executeInstruction(CPUCore& core) {
-    if (!core.currentProcess || core.currentProcess->isFinished) return;
-    
+// Takes the core's process off it and back to the ready queue. Caller holds the
+// domain's queueMutex.
+void Scheduler::requeue(SchedulerDomain& domain, CPUCore& core) {
+    Process* running = core.currentProcess;
+    running->state() = ProcessState::READY;
+    running->readyTick = cpuTicks;
+    domain.readyQueue->push(running);
+    queueSwapCandidate(domain, running);
+    freeCore(domain, core);
+}
+
+// Dispatches from the ready queue to idle cores, lowest slot first, until either runs
+// out. Caller holds the domain's queueMutex.
+template <typename Queue>
+void Scheduler::fillIdleCores(SchedulerDomain& domain, Queue& queue) {
+    while (!queue.empty()) {
+        int slot = domain.idleCores.first();
+        if (slot < 0) break;
+        CPUCore& core = *domain.cores[slot];
+        Process* next = takeNextReady(domain, queue, core);
+        if (!next) break; // nothing in reach fits in memory
+        dispatch(domain, core, next);
+    }
+}
+
+void Scheduler::freeCore(SchedulerDomain& domain, CPUCore& core) {
+    core.currentProcess = nullptr;
+    core.isRunning = false;
+    core.currentQuantum = 0;
+    domain.busyCores.reset(core.slot);
+    if (!core.draining) domain.idleCores.set(core.slot);
+}
+
+// Takes the processes that finished in the last burst off their cores
+void Scheduler::releaseFinishedCores(SchedulerDomain& domain) {
+    for (int slot : domain.finishedCores) {
+        CPUCore& core = *domain.cores[slot];
+        Process* process = core.currentProcess;
+        if (!process || !process->finished()) continue;
+        recordCompletion(process);
+        recordDeadline(process);
+        releaseMemory(process);
+        queueSwapCandidate(domain, process);
+        freeCore(domain, core);
+    }
+    domain.finishedCores.clear();
+}
+
+// Removes and returns the process core should run next. With cache-affinity enabled, the
+// first process within kAffinityScanDepth of the head that last ran on this core (or has
+// never run) is preferred; otherwise the head of the queue migrates here.
+//
+// Only a process whose memory is resident (or can be made so) is dispatched. If the
+// preferred one does not fit, the dispatch is deferred to the first process within
+// kMemoryScanDepth that does; nullptr if none does. The queue's find() decides what
+// "within" means: a lottery offers only the process it drew for this dispatch.
+template <typename Queue>
+Process* Scheduler::takeNextReady(SchedulerDomain& domain, Queue& queue, const CPUCore& core) {
+    queue.beginDispatch();
+    Process* pick = queue.front();
+    if (systemConfig.cacheAffinity) {
+        Process* local = queue.find(kAffinityScanDepth, [&](const Process* process) {
+            return process->coreId() == core.id || process->coreId() < 0;
+        });
+        if (local) pick = local;
+    }
+
+    if (!makeResident(domain, pick)) {
+        memory.recordDeferral();
+        pick = queue.find(kMemoryScanDepth, [&](Process* process) { return makeResident(domain, process); });
+        if (!pick) return nullptr;
+    }
+
+    queue.remove(pick);
+    return pick;
+}
+
+// Gives process a memory region if it has none, evicting ready processes from the back
+// of the queue (the ones furthest from running) until it fits, then pages its image in
+// if it was swapped out. Running processes keep their memory. Caller holds the domain's
+// queueMutex.
+bool Scheduler::makeResident(SchedulerDomain& domain, Process* process) {
+    if (process->memoryAddress < 0 && memory.enabled()) {
+        process->memoryAddress = memory.allocate(process->memorySize);
+        if (process->memoryAddress < 0) {
+            domain.readyQueue->visitFromBack([&](Process* victim) {
+                if (victim == process || victim->memoryAddress < 0) return true;
+                releaseMemory(victim);
+                memory.recordEviction();
+                process->memoryAddress = memory.allocate(process->memorySize);
+                return process->memoryAddress < 0;
+            });
+        }
+        if (process->memoryAddress < 0) return false;
+    }
+
+    std::lock_guard<std::mutex> swapLock(swapMutex);
+    if (process->swappedOut() && !swapIn(process)) {
+        releaseMemory(process);
+        return false;
+    }
+    return true;
+}
+
+void Scheduler::releaseMemory(Process* process) {
+    if (process->memoryAddress < 0) return;
+    memory.release(process->memoryAddress);
+    process->memoryAddress = -1;
+}
+
+// Starts process's idle clock: called whenever it enters a ready queue or finishes.
+// The epoch bump voids any earlier entry, including one in another domain.
+void Scheduler::queueSwapCandidate(SchedulerDomain& domain, Process* process) {
+    std::lock_guard<std::mutex> swapLock(swapMutex);
+    process->idleEpoch++;
+    if (!swap.isOpen() || systemConfig.swapThresholdMs <= 0) return;
+    domain.swapQueue.push_back({process, process->idleEpoch, std::chrono::steady_clock::now()});
+}
+
+// Swaps out every process of the domain that has been idle for swap-threshold-ms.
+// Candidates are queued in the order they went idle, so only the due ones at the front
+// are looked at; one that ran again or moved domain in the meantime has a newer entry
+// and its old one is dropped.
+void Scheduler::swapOutIdle(SchedulerDomain& domain) {
+    std::lock_guard<std::mutex> swapLock(swapMutex);
+    std::deque<SwapCandidate>& swapQueue = domain.swapQueue;
+    if (!swap.isOpen() || systemConfig.swapThresholdMs <= 0) {
+        swapQueue.clear();
+        return;
+    }
+
+    auto cutoff = std::chrono::steady_clock::now() - std::chrono::milliseconds(systemConfig.swapThresholdMs);
+    while (!swapQueue.empty() && swapQueue.front().since <= cutoff) {
+        SwapCandidate candidate = swapQueue.front();
+        swapQueue.pop_front();
+        Process* process = candidate.process;
+        // A current entry means the process is in this domain's queue or has finished
+        bool idle = candidate.idleEpoch == process->idleEpoch &&
+                    (process->finished() || process->state() == ProcessState::READY);
+        if (idle && !process->swappedOut() && process->pins == 0) {
+            swapOut(process);
+        }
+    }
+}
+
+bool Scheduler::swapOut(Process* process) {
+    auto start = std::chrono::steady_clock::now();
+    BinaryWriter out;
+    process->serializeImage(out);
+    long long offset = swap.store(out.finish());
+    if (offset < 0) return false;
+
+    process->dropImage();
+    process->swapOffset = offset;
+    releaseMemory(process);
+    swap.recordSwapOut(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+    return true;
+}
+
+bool Scheduler::swapIn(Process* process) {
+    auto start = std::chrono::steady_clock::now();
+    if (!loadImage(process)) {
+        process->dropImage();
+        console.notice("Failed to swap in " + process->name + ".");
+        return false;
+    }
+    swap.release(process->swapOffset);
+    process->swapOffset = -1;
+    swap.recordSwapIn(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+    return true;
+}
+
+// Reads process's image back from the swap file without giving up its slot
+bool Scheduler::loadImage(Process* process) {
+    std::string image;
+    if (!swap.load(process->swapOffset, image)) return false;
+    BinaryReader in(image.data(), image.size());
+    return in.readStringTable() && process->deserializeImage(in);
+}
+
+// Puts process on core. Every dispatch is a context switch costing context-switch-cycles.
+// A process resuming on a different core than it last ran on is also a migration and
+// pays migration-cost warm-up cycles before executing again.
+void Scheduler::dispatch(SchedulerDomain& domain, CPUCore& core, Process* process) {
+    contextSwitchCount++;
+    core.switchCycles = systemConfig.contextSwitchCycles;
+    domain.windowDispatches++;
+    domain.windowWaitTicks += cpuTicks - process->readyTick;
+
+    if (process->coreId() >= 0 && process->coreId() != core.id) {
+        migrationCount++;
+        process->migrations++;
+        core.warmupCycles = systemConfig.migrationCost;
+    } else {
+        core.warmupCycles = 0;
+    }
+
+    process->state() = ProcessState::RUNNING;
+    process->coreId() = core.id;
+    core.currentProcess = process;
+    core.isRunning = true;
+    core.currentQuantum = 0;
+    domain.idleCores.reset(core.slot);
+    domain.busyCores.set(core.slot);
+}
+
+// Runs one tick's burst on every busy core
+template <typename Policy>
+void Scheduler::executeCores(SchedulerDomain& domain) {
+    const std::vector<CPUCore*>& cores = domain.cores;
+    const int budget = std::max(1, systemConfig.instructionsPerTick);
+
+    domain.busyCores.forEach([&](int slot) {
+        CPUCore& core = *cores[slot];
+        domain.windowBusyCycles++;
+        executeBurst(domain, core, budget);
+        Process* process = core.currentProcess;
+        Policy::charge(process);
+        // A process that just finished has already left the share totals
+        if (Policy::kTicketed && !process->finished()) shareTotals[process->shareClass].ticks++;
+
+        // List the cores that need the scheduler's attention next tick
+        if (process->finished()) {
+            domain.finishedCores.push_back(slot);
+        } else if (Policy::kTimeSliced && ++core.currentQuantum >= quantumCycles) {
+            domain.expiredCores.push_back(slot);
+        }
+    });
+}
+
+// Threaded dispatch needs the GCC/Clang labels-as-values extension; other compilers
+// fall back to a switch with the same burst structure
+#if defined(__GNUC__)
+#define OPESY_THREADED_DISPATCH 1
+#else
+#define OPESY_THREADED_DISPATCH 0
+#endif
+
+// Runs up to budget instructions of the core's process in one call and returns how many
+// were retired. Sleep, overhead, finish and quantum conditions are handled at the burst
+// boundary only: inside the burst the program counter and operand arrays live in locals
+// and each handler jumps straight to the next one. A SLEEP ends the burst early.
+int Scheduler::executeBurst(SchedulerDomain& domain, CPUCore& core, int budget) {
+    std::vector<PrintRecord>& burstPrints = domain.burstPrints;
     Process* process = core.currentProcess;
+    if (!process || process->finished()) return 0;
     
-    if (process->currentInstruction >= process->instructions.size()) {
-        process->isFinished = true;
-        process->state = ProcessState::FINISHED;
-        process->finishTime = std::chrono::system_clock::now();
-        // std::cout << "\n" << process->name << " has finished execution.\n>";
-        return;
+    
+    // A sleeping process keeps its core but executes nothing until it wakes
+    if (process->sleepUntil > std::chrono::steady_clock::now()) return 0;
+    
+    // Context-switch overhead and cache warm-up after a migration burn cycles
+    // without retiring instructions
+    if (core.switchCycles > 0) {
+        core.switchCycles--;
+        switchCycleCount++;
+        domain.windowSwitchCycles++;
+        return 0;
+    }
+    if (core.warmupCycles > 0) {
+        core.warmupCycles--;
+        warmupCycleCount++;
+        return 0;
     }
     
-    // const Instruction& instr = process->instructions[process->currentInstruction];
-    Instruction& instr = process->instructions[process->currentInstruction];
-    instr.executedAt = std::chrono::system_clock::now();
+    Instruction* code = process->instructions.data();
+    const int end = (int)process->instructions.size();
+    int* vars = process->variables.data();
+    uint8_t* declared = process->variableDeclared.data();
+    int* loops = process->loopCounters.data();
+    int pc = process->currentInstruction();
+    int paid = process->weightPaid; // only ever non-zero for the op the burst starts at
+    int retired = 0;
     
-    switch (instr.type) {
-        case InstructionType::PRINT:
-            break;
-        case InstructionType::DECLARE:
-            process->variables[instr.varName] = instr.value;
-            break;
-        case InstructionType::ADD:
-            if (process->variables.find(instr.varName) != process->variables.end()) {
-                process->variables[instr.varName] += instr.value;
-            }
-            break;
-        case InstructionType::SUBTRACT:
-            if (process->variables.find(instr.varName) != process->variables.end()) {
-                process->variables[instr.varName] -= instr.value;
+    // PRINT timestamps share one clock read per burst
+    std::optional<std::chrono::system_clock::time_point> burstTime;
+    
+    if (pc >= end || budget <= 0) goto burst_done;
+
+#if OPESY_THREADED_DISPATCH
+#define OP(type) op_##type:
+#define DISPATCH() goto *dispatchTable[(int)code[pc].type]
+    {
+        // Indexed by InstructionType
+        static const void* const dispatchTable[] = {
+            &&op_PRINT, &&op_DECLARE, &&op_ADD, &&op_SUBTRACT, &&op_SLEEP, &&op_FOR_START, &&op_FOR_END
+        };
+        DISPATCH();
+#else
+#define OP(type) case InstructionType::type:
+#define DISPATCH() goto dispatch_switch
+    {
+dispatch_switch:
+        switch (code[pc].type) {
+#endif
+#define CONTINUE() do { if (retired >= budget || pc >= end) goto burst_done; DISPATCH(); } while (0)
+#define NEXT() do { retired++; CONTINUE(); } while (0)
+// Fused ops cost the number of source instructions they stand for. One the burst
+// cannot afford spends what is left, keeps its pc and takes effect in the burst that
+// pays it off, so folding never lets a tick retire more than its budget.
+#define PAY(weight) do { \
+        if ((weight) - paid > budget - retired) { paid += budget - retired; retired = budget; goto burst_done; } \
+        retired += (weight) - paid; \
+        paid = 0; \
+    } while (0)
+
+        OP(PRINT) {
+            if (!burstTime) burstTime = std::chrono::system_clock::now();
+            burstPrints.push_back({*burstTime, pc, core.id});
+            pc++;
+            NEXT();
+        }
+        OP(DECLARE) {
+            const Instruction& instr = code[pc];
+            vars[instr.varSlot] = instr.value;
+            declared[instr.varSlot] = 1;
+            pc++;
+            NEXT();
+        }
+        OP(ADD) {
+            // Wrapping arithmetic: overflow is defined and matches fused ops
+            const Instruction& instr = code[pc];
+            PAY(instr.weight);
+            if (declared[instr.varSlot]) {
+                vars[instr.varSlot] = (int)((unsigned)vars[instr.varSlot] + (unsigned)instr.value);
             }
-            break;
-        case InstructionType::SLEEP:
-            std::this_thread::sleep_for(std::chrono::milliseconds(instr.value * 10));
-            break;
-        case InstructionType::FOR_START:
-            process->forStack.push_back(process->currentInstruction);
-            process->forCounters.push_back(0);
-            break;
-        case InstructionType::FOR_END:
-            if (!process->forStack.empty()) {
-                int forStart = process->forStack.back();
-                int& counter = process->forCounters.back();
-                counter++;
-                
-                if (counter < process->instructions[forStart].value) {
-                    process->currentInstruction = forStart;
-                } else {
-                    process->forStack.pop_back();
-                    process->forCounters.pop_back();
-                }
+            pc++;
+            CONTINUE();
+        }
+        OP(SUBTRACT) {
+            const Instruction& instr = code[pc];
+            PAY(instr.weight);
+            if (declared[instr.varSlot]) {
+                vars[instr.varSlot] = (int)((unsigned)vars[instr.varSlot] - (unsigned)instr.value);
             }
-            break;
+            pc++;
+            CONTINUE();
+        }
+        OP(SLEEP) {
+            process->sleepUntil = std::chrono::steady_clock::now() + std::chrono::milliseconds(code[pc].value * 10);
+            pc++;
+            retired++;
+            goto burst_done;
+        }
+        OP(FOR_START) {
+            // Loops were resolved at load time: each FOR owns a counter slot and
+            // both ends carry direct jump targets
+            const Instruction& instr = code[pc];
+            loops[instr.loopSlot] = instr.value;
+            pc = instr.value > 0 ? pc + 1 : instr.jumpTarget;
+            NEXT();
+        }
+        OP(FOR_END) {
+            const Instruction& instr = code[pc];
+            pc = --loops[instr.loopSlot] > 0 ? instr.jumpTarget : pc + 1;
+            NEXT();
+        }
+#if !OPESY_THREADED_DISPATCH
+        }
+#endif
+    }
+#undef PAY
+#undef NEXT
+#undef CONTINUE
+#undef DISPATCH
+#undef OP
+
+burst_done:
+    process->currentInstruction() = pc;
+    process->weightPaid = paid;
+    retiredInstructions += retired;
+    if (!burstPrints.empty()) {
+        process->printLog.append(burstPrints);
+        burstPrints.clear();
     }
     
-    process->currentInstruction++;
+    if (pc >= end) {
+        liveProcesses--;
+        process->finished() = 1;
+        process->state() = ProcessState::FINISHED;
+        process->finishTime = std::chrono::system_clock::now();
+        removeFromTotals(process);
+    }
     
-    if (systemConfig.delayPerExec > 0) {
-        std::this_thread::sleep_for(std::chrono::milliseconds(systemConfig.delayPerExec));
+    if (systemConfig.delayPerExec > 0 && retired > 0) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(systemConfig.delayPerExec) * retired);
     }
+    return retired;
 }
 
 void Scheduler::processGenerationLoop() {
     int automaticProcessCounter = 0; // separate counter for dummy processes
     const int maxTotalProcesses = 8;
 
-    while (isRunning && allProcesses.size() < maxTotalProcesses) {
-        std::this_thread::sleep_for(std::chrono::seconds(systemConfig.batchProcessFreq));
-        
-        if (isRunning && allProcesses.size() < maxTotalProcesses) {
+    // processCount() takes tableMutex, which ranks above wakeMutex, so the table is
+    // only counted with wakeMutex released
+    while (isRunning && processCount() < maxTotalProcesses) {
+        {
+            // Wait out the batch period, but return as soon as the scheduler is stopped
+            // or reloaded so a new batch-process-freq applies immediately
+            std::unique_lock<std::mutex> wake(wakeMutex);
+            int seenConfigVersion = configVersion;
+            bool interrupted = schedulerCV.wait_for(wake, std::chrono::seconds(systemConfig.batchProcessFreq),
+                                 [&] { return !isRunning || configVersion != seenConfigVersion; });
+            if (interrupted) continue;
+        }
+
+        if (isRunning && processCount() < maxTotalProcesses) {
             std::string processName = "process" + std::to_string(automaticProcessCounter);
             automaticProcessCounter++;
             addProcess(processName);
@@ -406,13 +2136,74 @@ void Scheduler::processGenerationLoop() {
     }
 }
 
+// Nudges quantum-cycles toward autotune-target. Overhead above the target means slices
+// are too short for the context-switch cost, so the quantum doubles; overhead well
+// under the target leaves room to halve it for shorter ready-queue waits. Response
+// time bounds the trade: while the mean wait per dispatch is over autotune-max-wait
+// the quantum never grows, and it halves unless overhead is already over the target.
+void Scheduler::autotuneQuantum() {
+    // Runs on whichever domain thread advanced the clock, so two ticks' calls can overlap
+    std::lock_guard<std::mutex> lock(historyMutex);
+
+    // Keep accumulating until the window spans a couple of full slices per core,
+    // otherwise a long quantum looks switch-free or switch-heavy by accident
+    long long windowBusyCycles = 0;
+    for (const auto& domain : domains) {
+        windowBusyCycles += domain.windowBusyCycles;
+    }
+    int current = quantumCycles;
+    if (windowBusyCycles == 0 || windowBusyCycles < 2LL * current * (long long)cores.size()) {
+        return;
+    }
+
+    // Take the window: each counter is read and cleared in one step, so what the other
+    // domains add meanwhile lands in this window or the next, never in neither
+    long long windowSwitchCycles = 0, windowDispatches = 0, windowWaitTicks = 0;
+    windowBusyCycles = 0;
+    for (auto& domain : domains) {
+        windowBusyCycles += domain.windowBusyCycles.exchange(0);
+        windowSwitchCycles += domain.windowSwitchCycles.exchange(0);
+        windowDispatches += domain.windowDispatches.exchange(0);
+        windowWaitTicks += domain.windowWaitTicks.exchange(0);
+    }
+
+    QuantumSample sample;
+    sample.tick = cpuTicks;
+    sample.switchOverhead = (double)windowSwitchCycles / windowBusyCycles;
+    sample.avgWaitTicks = windowDispatches ? (double)windowWaitTicks / windowDispatches : 0.0;
+
+    int quantum = current;
+    bool waitTooLong = systemConfig.autotuneMaxWait > 0 && sample.avgWaitTicks > systemConfig.autotuneMaxWait;
+    if (waitTooLong) {
+        if (sample.switchOverhead <= systemConfig.autotuneTarget) quantum = std::max(1, quantum / 2);
+    } else if (sample.switchOverhead > systemConfig.autotuneTarget) {
+        quantum = std::min(quantum * 2, (int)kMaxAutotuneQuantum);
+    } else if (sample.switchOverhead < systemConfig.autotuneTarget / 2) {
+        quantum = std::max(1, quantum / 2);
+    }
+    sample.quantum = quantum;
+
+    if (quantum != current || quantumHistory.empty()) {
+        quantumHistory.push_back(sample);
+        if (quantumHistory.size() > kQuantumHistoryLength) {
+            quantumHistory.pop_front();
+        }
+    }
+    quantumCycles = quantum;
+}
+
 double Scheduler::calculateCPUUtilization() {
     if (!isRunning){
         return 0.0;
     }
     
+    if (cores.empty()) {
+        return 0.0;
+    }
+    
+    // Cores still draining after a reload count as capacity until they are removed
     int activeCores = getActiveCores();
-    return (double)activeCores / systemConfig.numCPU * 100.0;
+    return (double)activeCores / cores.size() * 100.0;
 }
 
 int Scheduler::getActiveCores() {
@@ -4,55 +4,348 @@
 #include <string>
 #include <vector>
 #include <map>
-#include <queue>
+#include <set>
+#include <deque>
+#include <unordered_map>
 #include <mutex>
+#include <shared_mutex>
+#include <atomic>
+#include <condition_variable>
 #include <thread>
 #include <chrono>
 #include <memory>
+#include <ostream>
+#include <cstdint>
 #include "Process.h"
+#include "Config.h"
+#include "LockStats.h"
+#include "MemoryManager.h"
+#include "SwapStore.h"
+#include "StatsServer.h"
+#include "UtilizationLog.h"
+#include "SchedulingPolicy.h"
 
-// CPU Core class
+// CPU Core class. Only the scheduling thread writes a core's fields; currentProcess and
+// currentQuantum are atomic so screen -ls, report-util and the stats snapshot can read
+// them concurrently.
 class CPUCore {
 public:
     int id;
-    Process* currentProcess;
+    int slot; // index in its domain's cores
+    std::atomic<Process*> currentProcess;
     bool isRunning;
-    int currentQuantum;
+    std::atomic<int> currentQuantum;
+    bool draining; // removed by reload-config; takes no new processes and is dropped once idle
+    int switchCycles; // context-switch overhead cycles left before the process executes
+    int warmupCycles; // cycles left before a migrated process executes again
     
     CPUCore(int coreId);
 };
 
+// A set of core slots, one bit each. Finding a set bit or walking them costs a word
+// per 64 cores, so the scheduling loop can find an idle core or visit only the busy
+// ones without looking at every core.
+class CoreMask {
+public:
+    void resize(size_t bits) { words.assign((bits + 63) / 64, 0); }
+    void set(int bit) { words[bit >> 6] |= 1ULL << (bit & 63); }
+    void reset(int bit) { words[bit >> 6] &= ~(1ULL << (bit & 63)); }
+    bool test(int bit) const { return (words[bit >> 6] >> (bit & 63)) & 1; }
+    bool any() const { return first() >= 0; }
+
+    // Lowest set bit, or -1 if none is
+    int first() const {
+        for (size_t w = 0; w < words.size(); w++) {
+            if (words[w]) return (int)(w * 64) + lowestBit(words[w]);
+        }
+        return -1;
+    }
+
+    // Calls fn(bit) for every set bit in ascending order. fn may clear bits it has
+    // been called for.
+    template <typename Fn>
+    void forEach(Fn fn) const {
+        for (size_t w = 0; w < words.size(); w++) {
+            for (uint64_t bits = words[w]; bits; bits &= bits - 1) {
+                fn((int)(w * 64) + lowestBit(bits));
+            }
+        }
+    }
+
+private:
+    static int lowestBit(uint64_t bits) {
+#if defined(__GNUC__)
+        return __builtin_ctzll(bits);
+#else
+        int bit = 0;
+        while (!(bits & 1)) { bits >>= 1; bit++; }
+        return bit;
+#endif
+    }
+
+    std::vector<uint64_t> words;
+};
+
+// One quantum auto-tuner decision, kept for reporting
+struct QuantumSample {
+    int tick;
+    int quantum;
+    double switchOverhead; // overhead cycles / busy core cycles over the window
+    double avgWaitTicks;   // mean ready-queue wait per dispatch over the window
+};
+
+// A process that went idle - entered a ready queue or finished - and may be swapped
+// out once it has stayed that way for swap-threshold-ms
+struct SwapCandidate {
+    Process* process;
+    int idleEpoch; // the process's idleEpoch when queued; stale once it differs
+    std::chrono::steady_clock::time_point since;
+};
+
+// One partition of the scheduler: the cores whose id modulo the domain count is its
+// id, with its own ready queue, queue lock and scheduling thread, so domains tick
+// without contending for a queue. The balancer moves ready processes between them.
+struct SchedulerDomain {
+    int id;
+    std::vector<CPUCore*> cores; // rebuilt whenever the core set changes, under coreMutex
+    
+    // Core state by slot, kept current by dispatch and release so a tick costs what
+    // changed rather than a pass over every core. Only the domain's thread writes them.
+    CoreMask idleCores;              // no process and not draining: free to dispatch to
+    CoreMask busyCores;              // has a process
+    std::vector<int> finishedCores;  // process finished in the last burst
+    std::vector<int> expiredCores;   // process used up its round-robin quantum
+    std::unique_ptr<RunQueue> readyQueue; // of the active policy's queue type
+    std::mutex queueMutex;
+    std::string queueLockName;
+    LockStats queueStats;
+    bool wakePending; // an arrival its loop has not seen yet; under the scheduler's wakeMutex
+    std::deque<SwapCandidate> swapQueue; // oldest first; under the scheduler's swapMutex
+    
+    // Scratch buffer reused by executeBurst() every tick
+    std::vector<PrintRecord> burstPrints; // PRINTs of the running burst, logged at its end
+    
+    // Quantum auto-tuner window counters; the tuner sums and clears them across domains
+    std::atomic<long long> windowBusyCycles;
+    std::atomic<long long> windowSwitchCycles;
+    std::atomic<long long> windowDispatches;
+    std::atomic<long long> windowWaitTicks;
+    
+    // Ready processes the balancer moved in and out
+    std::atomic<long long> balancedIn;
+    std::atomic<long long> balancedOut;
+    
+    explicit SchedulerDomain(int domainId);
+};
+
 // Scheduler class
 class Scheduler {
 private:
-    std::vector<CPUCore> cores;
-    std::queue<Process*> readyQueue;
-    // std::vector<Process> allProcesses;
-    std::vector<std::unique_ptr<Process>> allProcesses;
-    std::mutex schedulerMutex;
+    std::deque<CPUCore> cores; // a deque so growing the set never moves a core
+    std::deque<SchedulerDomain> domains;
+    ProcessTable allProcesses; // indexed by pid
+    std::unordered_map<std::string, Process*> processIndex; // name -> first process with it
+    
+    // Locks, always taken in this order:
+    //   coreMutex  - the core set, the domains' core lists and per-tick scheduler state.
+    //                The scheduling loops and observers hold it shared; reload,
+    //                checkpoint and restore exclusively.
+    //   tableMutex - allProcesses and processIndex; exclusive only to add or restore.
+    //   queueMutex - a domain's readyQueue. Several are taken in domain order.
+    //   wakeMutex  - wakePending, isRunning and configVersion changes, for schedulerCV.
+    //   swapMutex  - swap, the swap queues and every process's swapOffset, pins and idleEpoch.
+    std::shared_mutex coreMutex;
+    std::shared_mutex tableMutex;
+    std::mutex wakeMutex;
+    std::mutex historyMutex; // quantumHistory, and serialises autotuneQuantum()
+    std::mutex swapMutex;
+    std::condition_variable schedulerCV; // signalled on process arrival, reload and stop
+    
+    LockStats coreSharedStats{"core set (shared)"};
+    LockStats coreExclusiveStats{"core set (exclusive)"};
+    LockStats tableSharedStats{"process table (shared)"};
+    LockStats tableExclusiveStats{"process table (exclusive)"};
+    
     bool isInitialized;
-    bool isRunning;
-    bool allProcessesFinishedMessageShown;
-    int processCounter;
+    std::atomic<bool> isRunning;
+    std::atomic<bool> allProcessesFinishedMessageShown;
+    std::atomic<long long> liveProcesses; // admitted and not finished
     std::chrono::system_clock::time_point startTime;
-    int cpuTicks;
+    // Scheduler-wide tick count. Every domain ticks every 100 ms; whichever gets there
+    // first in a period advances it (see advanceClock()).
+    std::atomic<int> cpuTicks;
+    std::atomic<long long> nextClockTick; // steady-clock ns at which cpuTicks may advance again
+    std::atomic<int> configVersion; // bumped by reloadConfig() so waiting loops pick up new settings
+    
+    // Written only by the scheduling thread, read by the reports
+    std::atomic<long long> migrationCount;
+    std::atomic<long long> warmupCycleCount;
+    std::atomic<long long> contextSwitchCount;
+    std::atomic<long long> switchCycleCount;
+    std::atomic<long long> retiredInstructions;
+    
+    // The quantum in effect: quantum-cycles as configured, or as the auto-tuner last set
+    // it. Atomic because the tuner runs on whichever domain thread advanced the clock
+    // while the others read it.
+    std::atomic<int> quantumCycles;
+    
+    // Quantum auto-tuner decision history
+    std::deque<QuantumSample> quantumHistory;
+    static const int kMaxAutotuneQuantum = 1024;
+    static const size_t kQuantumHistoryLength = 64;
+    
+    // Checkpoint file header: magic, format version and a byte-order probe
+    static constexpr char kCheckpointMagic[4] = {'O', 'P', 'C', 'K'};
+    static constexpr uint32_t kCheckpointVersion = 11;
+    static constexpr uint32_t kByteOrderMark = 0x01020304;
+    
+    // How far into the ready queue an idle core looks for a process that last ran on it
+    static const int kAffinityScanDepth = 32;
+    // ... and, when the head's memory cannot be made resident, for one that fits
+    static const int kMemoryScanDepth = 32;
+    // How often the balancer evens out the domains' ready queues
+    static constexpr int kBalanceIntervalMs = 100;
+    // Ready processes the stats snapshot lists per domain, from the front of its queue
+    static const int kStatsReadyListed = 64;
+    // Most recent log segments listed individually by report-util
+    static const size_t kReportedSegments = 16;
+    
+    // The policy chosen at initialize: the loop every domain runs, instantiated for it,
+    // and its run-queue type
+    struct PolicyEntry {
+        const char* name;
+        void (Scheduler::*loop)(SchedulerDomain&);
+        std::unique_ptr<RunQueue> (*makeQueue)();
+        bool ticketed;
+    };
+    const PolicyEntry* activePolicy;
+    
+    template <typename Policy>
+    static PolicyEntry policyEntry();
+    static const std::vector<PolicyEntry>& policies();
+    static const PolicyEntry* findPolicy(const std::string& name);
+    static std::string policyNames();
+    
+    MemoryManager memory;
+    
+    SwapStore swap;
+    
+    StatsServer statsServer;
+    
+    UtilizationLog utilLog;
+    std::mutex completionMutex;
+    std::vector<CompletionRecord> completions; // finished since the last log sample
+    
+    // How finished processes with a deadline fared; guarded by completionMutex. Misses
+    // are bucketed by lateness: up to 10 ms, 100 ms, 1 s, 10 s, and beyond.
+    static const int kLatenessBuckets = 5;
+    struct DeadlineStats {
+        long long met = 0;
+        long long missed = 0;
+        long long latenessMsSum = 0;
+        long long latenessMsMax = 0;
+        long long missesByLateness[kLatenessBuckets] = {};
+    };
+    DeadlineStats deadlineStats;
+    // Due times of unfinished processes with a deadline, also under completionMutex.
+    // Ones found past due when the report runs move to overdueDeadlines, so the report
+    // looks at each process at most once rather than walking the table.
+    std::multiset<std::chrono::system_clock::time_point> pendingDeadlines;
+    long long overdueDeadlines = 0;
+    std::chrono::system_clock::time_point overdueCutoff;
+    
+    // One entry of the tickets config: a name, or a prefix when pattern ends in '*'
+    struct TicketRule {
+        std::string pattern;
+        int tickets;
+        bool matches(const std::string& name) const;
+    };
+    std::vector<TicketRule> ticketRules; // guarded by tableMutex
+
+    // Share report totals over unfinished processes, one per ticket rule plus "(other)"
+    // last, kept up at admission, charge and finish. Only rebuilt with the cores stopped
+    // (coreMutex and tableMutex exclusive), so the counters are updated lock-free.
+    struct ShareTotals {
+        std::atomic<int> processes{0};
+        std::atomic<long long> tickets{0};
+        std::atomic<long long> ticks{0};
+    };
+    std::vector<ShareTotals> shareTotals;
     
-    void schedulingLoop();
-    void roundRobinSchedule();
-    void fcfsSchedule();
-    void executeInstruction(CPUCore& core);
+    template <typename Policy>
+    void schedulingLoop(SchedulerDomain& domain);
+    void balanceLoop();
+    void balanceDomains();
+    bool advanceClock(std::chrono::steady_clock::time_point now);
+    void checkAllFinished();
+    void assignCoresToDomains();
+    template <typename Policy>
+    void schedule(SchedulerDomain& domain);
+    template <typename Policy>
+    void preemptExpired(SchedulerDomain& domain);
+    template <typename Policy>
+    void preemptOutranked(SchedulerDomain& domain);
+    void requeue(SchedulerDomain& domain, CPUCore& core);
+    template <typename Queue>
+    void fillIdleCores(SchedulerDomain& domain, Queue& queue);
+    void freeCore(SchedulerDomain& domain, CPUCore& core);
+    void releaseFinishedCores(SchedulerDomain& domain);
+    template <typename Queue>
+    Process* takeNextReady(SchedulerDomain& domain, Queue& queue, const CPUCore& core);
+    bool makeResident(SchedulerDomain& domain, Process* process);
+    void releaseMemory(Process* process);
+    void queueSwapCandidate(SchedulerDomain& domain, Process* process);
+    void swapOutIdle(SchedulerDomain& domain);
+    // Caller holds swapMutex
+    bool swapOut(Process* process);
+    bool swapIn(Process* process);
+    bool loadImage(Process* process);
+    void printMemoryStats();
+    void dispatch(SchedulerDomain& domain, CPUCore& core, Process* process);
+    void autotuneQuantum();
+    template <typename Policy>
+    void executeCores(SchedulerDomain& domain);
+    int executeBurst(SchedulerDomain& domain, CPUCore& core, int budget);
     void processGenerationLoop();
+    void replayLoop(std::string filename, double speed);
+    void startSchedulingLoop();
+    void resizeCores(int numCPU);
+    void removeDrainedCores();
+    void printDomains(std::ostream& out);
+    bool configureTickets(const std::string& spec);
+    const TicketRule* findTicketRule(const std::string& name) const;
+    void printShares(std::ostream& out);
+    void addToTotals(Process* process);
+    void removeFromTotals(const Process* process);
+    void rebuildTotals();
+    void configureStatsServer();
+    void publishStats();
+    void configureUtilizationLog();
+    void utilizationLogLoop();
+    void logUtilization();
+    void recordCompletion(const Process* process);
+    void recordDeadline(const Process* process);
+    void printDeadlines(std::ostream& out);
+    void reportUtilFromLog();
+    size_t processCount();
     
 public:
     Scheduler();
     
     bool initialize();
+    void reloadConfig(const Config& newConfig);
     void schedulerTest();
     void schedulerStop();
     void addProcess(const std::string& processName);
+    void addProcess(std::unique_ptr<Process> process);
+    void replay(const std::string& filename, double speed);
     void printScreen();
     void screenProcess(const std::string& processName);
     void reportUtil();
+    bool checkpoint(const std::string& filename);
+    bool restore(const std::string& filename);
+    void lockStats(bool reset);
+    void vmstat();
     
     // Utility methods
     double calculateCPUUtilization();
@@ -61,8 +354,9 @@ public:
     
     // Get process information for screen sessions
     Process* getProcess(const std::string& processName);
-    //std::vector<Process>& getAllProcesses() { return allProcesses; }
-    std::vector<std::unique_ptr<Process>>& getAllProcesses() { return allProcesses; }
+    // Pages the process in if it is swapped out and keeps it in memory until unpinned
+    Process* pinProcess(const std::string& processName);
+    void unpinProcess(Process* process);
 
 };
 
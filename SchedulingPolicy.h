@@ -0,0 +1,157 @@
+#ifndef SCHEDULING_POLICY_H
+#define SCHEDULING_POLICY_H
+
+#include "RunQueue.h"
+
+// Scheduling policies. Each one is a set of compile-time traits that
+// Scheduler::schedulingLoop<Policy> is instantiated with, so a domain's loop never
+// asks which policy is active. The policy is chosen once, by name, at initialize.
+//
+// A policy provides:
+//   Queue       - its run-queue type, derived from RunQueue. Its dispatch side
+//                 (front, find, remove) is called directly by the loop.
+//   kName       - the config's scheduler value that selects it
+//   kTimeSliced - whether a running process is preempted after quantum-cycles ticks
+//   kTicketed   - whether processes get tickets (and the share report applies)
+//   kPreemptive - whether a waiting process can take a core mid-slice; if so
+//                 outranks(waiting, running) says when
+//   charge(p)   - accounts one tick p held a core
+//   preempts(queue, p) - for time-sliced policies: whether p, its slice used up,
+//                 gives up its core; otherwise it starts a new slice
+//
+// Adding a policy means defining its traits (and queue, if it needs a new order) and
+// listing it in Scheduler::policies(), the registry findPolicy() and policyNames() read.
+
+// First come, first served: a process keeps its core until it finishes
+struct FcfsPolicy {
+    using Queue = FifoRunQueue;
+    static constexpr const char* kName = "fcfs";
+    static constexpr bool kTimeSliced = false;
+    static constexpr bool kTicketed = false;
+    static constexpr bool kPreemptive = false;
+    static void charge(Process*) {}
+};
+
+// Round robin: arrival order, preempted back to the end of the queue every quantum
+struct RoundRobinPolicy {
+    using Queue = FifoRunQueue;
+    static constexpr const char* kName = "rr";
+    static constexpr bool kTimeSliced = true;
+    static constexpr bool kTicketed = false;
+    static constexpr bool kPreemptive = false;
+    static void charge(Process*) {}
+    static bool preempts(const Queue&, const Process*) { return true; }
+};
+
+// Completely fair: each tick on a core adds to a process's virtual runtime in inverse
+// proportion to its nice weight, and the ready process with the least runs next. A
+// process whose quantum is up keeps its core unless someone is waiting with less.
+struct CfsPolicy {
+    using Queue = VruntimeRunQueue;
+    static constexpr const char* kName = "cfs";
+    static constexpr bool kTimeSliced = true;
+    static constexpr bool kTicketed = false;
+    static constexpr bool kPreemptive = false;
+
+    // vruntime units per tick at nice 0
+    static constexpr long long kNice0Tick = 1024;
+
+    // Weight by nice value (-20..19); each step is ~1.25x the CPU share of the next
+    static int weight(int nice) {
+        static const int kWeights[40] = {
+            88761, 71755, 56483, 46273, 36291, 29154, 23254, 18705, 14949, 11916,
+            9548, 7620, 6100, 4904, 3906, 3121, 2501, 1991, 1586, 1277,
+            1024, 820, 655, 526, 423, 335, 272, 215, 172, 137,
+            110, 87, 70, 56, 45, 36, 29, 23, 18, 15
+        };
+        return kWeights[std::min(std::max(nice, kMinNice), kMaxNice) - kMinNice];
+    }
+
+    static void charge(Process* process) {
+        process->vruntime += kNice0Tick * 1024 / weight(process->nice);
+    }
+
+    static bool preempts(const Queue& queue, const Process* running) {
+        return !queue.empty() && queue.front()->vruntime < running->vruntime;
+    }
+
+    static constexpr int kMinNice = -20;
+    static constexpr int kMaxNice = 19;
+};
+
+// Tickets of a process no ticket rule or --tickets covers, and the most one can hold
+const int kDefaultTickets = 100;
+const int kMaxTickets = 1000000;
+
+// Stride: deterministic proportional share. Each tick on a core advances a process's
+// pass (kept in vruntime) by a stride inversely proportional to its tickets, and the
+// least pass runs next, so CPU time follows the ticket ratio within a quantum or so.
+struct StridePolicy {
+    using Queue = VruntimeRunQueue;
+    static constexpr const char* kName = "stride";
+    static constexpr bool kTimeSliced = true;
+    static constexpr bool kTicketed = true;
+    static constexpr bool kPreemptive = false;
+
+    static constexpr long long kStride1 = 1 << 20;
+
+    static void charge(Process* process) {
+        process->vruntime += kStride1 / std::max(process->tickets, 1);
+        process->ticksRun++;
+    }
+
+    static bool preempts(const Queue& queue, const Process* running) {
+        return !queue.empty() && queue.front()->vruntime < running->vruntime;
+    }
+};
+
+// Lottery: randomized proportional share. Every quantum the core goes to the holder of
+// a ticket drawn from all the ready processes hold, so shares hold in expectation.
+struct LotteryPolicy {
+    using Queue = LotteryRunQueue;
+    static constexpr const char* kName = "lottery";
+    static constexpr bool kTimeSliced = true;
+    static constexpr bool kTicketed = true;
+    static constexpr bool kPreemptive = false;
+
+    static void charge(Process* process) { process->ticksRun++; }
+    // The preempted process rejoins the draw, so it can win its core back
+    static bool preempts(const Queue&, const Process*) { return true; }
+};
+
+// Earliest deadline first: the ready process whose deadline comes first runs, and takes
+// a core from a running one with a later deadline as soon as it is waiting. Processes
+// without a deadline run after, first come first served.
+struct EdfPolicy {
+    using Queue = DeadlineRunQueue;
+    static constexpr const char* kName = "edf";
+    static constexpr bool kTimeSliced = false;
+    static constexpr bool kTicketed = false;
+    static constexpr bool kPreemptive = true;
+    static void charge(Process*) {}
+
+    static bool outranks(const Process* waiting, const Process* running) {
+        return Queue::deadlineOf(waiting) < Queue::deadlineOf(running);
+    }
+};
+
+// Mixed: processes with a deadline are scheduled as under edf and preempt the rest,
+// which share what is left round robin
+struct EdfRoundRobinPolicy {
+    using Queue = DeadlineRunQueue;
+    static constexpr const char* kName = "edf-rr";
+    static constexpr bool kTimeSliced = true;
+    static constexpr bool kTicketed = false;
+    static constexpr bool kPreemptive = true;
+    static void charge(Process*) {}
+
+    static bool outranks(const Process* waiting, const Process* running) {
+        return EdfPolicy::outranks(waiting, running);
+    }
+
+    // A deadline process runs until one with an earlier deadline is waiting, which
+    // outranks() already sees to; the others are sliced
+    static bool preempts(const Queue&, const Process* running) { return running->deadlineMs <= 0; }
+};
+
+#endif
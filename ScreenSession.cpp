@@ -1,5 +1,7 @@
 #include "ScreenSession.h"
 #include "Scheduler.h"
+#include "SchedulingPolicy.h"
+#include "Console.h"
 #include <iostream>
 #include <ctime>
 #include <iomanip>
@@ -11,6 +13,9 @@ extern void clearScreen();
 
 std::map<std::string, ScreenSession> screens;
 
+// Most PRINT log entries a single process-smi shows, and its page size
+static const size_t kSmiMaxLines = 20;
+
 std::string getCurrentTimestamp() {
     std::time_t now = std::time(nullptr);
     std::tm* local = std::localtime(&now);
@@ -20,38 +25,55 @@ std::string getCurrentTimestamp() {
     return oss.str();
 }
 
+// Screen control; headless sessions just print line after line
+static void clearTerminal() {
+    if (!console.headless()) std::system("cls");
+}
+
+static void moveToLine(int line, bool clearLine) {
+    if (console.headless()) return;
+    std::cout << "\033[" << line << ";1H";
+    if (clearLine) std::cout << "\033[2K";
+}
+
 void displayHeader(const std::string& sessionName) {
     Process* realProcess = globalScheduler.getProcess(sessionName);
     if (!realProcess) return;
     
-    std::cout << "\033[1;1H";  
+    moveToLine(1, false);
     std::cout << "\n";
-    std::cout << "\033[31m=========== SCREEN : " << sessionName << " ===========\033[0m\n";
+    if (console.headless()) {
+        std::cout << "=========== SCREEN : " << sessionName << " ===========\n";
+    } else {
+        std::cout << "\033[31m=========== SCREEN : " << sessionName << " ===========\033[0m\n";
+    }
     std::cout << "Process Name          : " << realProcess->name << "\n";
-    std::cout << "Instruction Progress  : " << realProcess->currentInstruction << " / " << realProcess->instructions.size() << "\n";
+    std::cout << "Instruction Progress  : " << realProcess->currentLine() << " / " << realProcess->lineCount << "\n";
     
     // Format creation time
     auto time_t = std::chrono::system_clock::to_time_t(realProcess->creationTime);
     std::cout << "Created At            : " << std::put_time(std::localtime(&time_t), "%m/%d/%Y, %I:%M:%S %p") << "\n";
     
     // Show status
-    if (realProcess->isFinished) {
+    if (realProcess->finished()) {
         std::cout << "Status                : FINISHED\n";
     } else {
-        std::string status = (realProcess->state == ProcessState::RUNNING) ? "RUNNING" : "READY";
+        std::string status = (realProcess->state() == ProcessState::RUNNING) ? "RUNNING" : "READY";
         std::cout << "Status                : " << status << "\n";
     }
     
     // Show core
-    if (realProcess->coreId >= 0) {
-        std::cout << "Core                  : " << realProcess->coreId << "\n";
+    if (realProcess->coreId() >= 0) {
+        std::cout << "Core                  : " << realProcess->coreId() << "\n";
     } else {
         std::cout << "Core                  : Not assigned\n";
     }
 }
 
 void screenSessionInterface(ScreenSession& session) {
-    std::system("cls"); 
+    // The session positions the cursor itself, so background output waits until it ends
+    console.acquire();
+    clearTerminal();
     displayHeader(session.name);
 
     int baseLine = 9; 
@@ -60,78 +82,130 @@ void screenSessionInterface(ScreenSession& session) {
 
     while (true) {
         // Move to the current prompt line
-        std::cout << "\033[" << currentLine << ";1H";
+        moveToLine(currentLine, false);
         std::cout << "(" << session.name << ")> ";
         std::cout.flush();
 
-        std::getline(std::cin, input);
+        if (!std::getline(console.input(), input)) {
+            input = "exit"; // end of input
+        }
+        if (console.headless()) {
+            std::cout << input << "\n"; // echo, as a terminal would
+        }
 
         if (input == "exit") {
             break;
         } else if (input == "clear") {
-            std::system("cls");
+            clearTerminal();
             displayHeader(session.name);
 
             currentLine = baseLine;
             
-        } else if (input == "process-smi") {
+        } else if (input.rfind("process-smi", 0) == 0) {
             // Show detailed process information
             Process* smiProcess = globalScheduler.getProcess(session.name);
+            std::istringstream args(input);
+            std::string cmd, option;
+            args >> cmd >> option;
+
             if (smiProcess) {
                 int printedLines = 0;
 
                 currentLine += 2;
 
                 auto printLine = [&](const std::string& text) {
-                    std::cout << "\033[" << (currentLine + printedLines) << ";1H\033[2K";
+                    moveToLine(currentLine + printedLines, true);
                     std::cout << text << std::endl;
                     ++printedLines;
                 };
 
-                printLine("Process name: " + smiProcess->name);
-                printLine("ID: " + std::to_string(smiProcess->id));
-                printLine("Logs:");
-                
-            
-                for (int i = 0; i < smiProcess->currentInstruction && i < smiProcess->instructions.size(); ++i) {
-                    const Instruction& instr = smiProcess->instructions[i];
-                    if (instr.type == InstructionType::PRINT) {
+                // Pick the slice of the PRINT log to show; only that slice is copied,
+                // however long the process has been running
+                const PrintLog& log = smiProcess->printLog;
+                size_t total = log.size();
+                size_t first = 0, count = 0;
+                std::string note;
+                bool valid = true;
 
-                        /*std::time_t now = std::time(nullptr);
-                        std::tm* local = std::localtime(&now);
-                        std::ostringstream timestamp;
-                        timestamp << "(" << std::put_time(local, "%m/%d/%Y %I:%M:%S%p") << ")";
-                        printLine(timestamp.str() + " Core:" + std::to_string(smiProcess->coreId) + " " + instr.msg);*/
+                if (option.empty()) {
+                    // Entries logged since the last process-smi
+                    first = std::min(session.logCursor, total);
+                    count = total - first;
+                    if (count > kSmiMaxLines) {
+                        note = "(" + std::to_string(count - kSmiMaxLines) + " earlier new entries skipped; use --page to see them)";
+                        first = total - kSmiMaxLines;
+                        count = kSmiMaxLines;
+                    } else if (count == 0) {
+                        note = "(no new entries)";
+                    }
+                    session.logCursor = total;
+                } else if (option == "--tail") {
+                    long long tail;
+                    valid = (bool)(args >> tail) && tail >= 0;
+                    if (valid) {
+                        count = std::min((size_t)tail, total);
+                        first = total - count;
+                        session.logCursor = total;
+                    }
+                } else if (option == "--page") {
+                    size_t pages = std::max<size_t>(1, (total + kSmiMaxLines - 1) / kSmiMaxLines);
+                    long long page;
+                    if (!(args >> page)) {
+                        page = (long long)session.logPage + 1; // next page
+                    }
+                    valid = page >= 1;
+                    if (valid) {
+                        page = std::min<long long>(page, (long long)pages);
+                        first = (size_t)(page - 1) * kSmiMaxLines;
+                        count = kSmiMaxLines;
+                        session.logPage = (size_t)page;
+                        note = "(page " + std::to_string(page) + " of " + std::to_string(pages) + ")";
+                    }
+                } else {
+                    valid = false;
+                }
+
+                if (!valid) {
+                    printLine("Usage: process-smi [--tail N | --page [N]]");
+                } else {
+                    printLine("Process name: " + smiProcess->name);
+                    printLine("ID: " + std::to_string(smiProcess->id));
+                    printLine("Logs:");
 
+                    for (const PrintRecord& record : log.read(first, count)) {
+                        std::time_t execTime = std::chrono::system_clock::to_time_t(record.time);
                         std::ostringstream timestamp;
-                        
-                        if (instr.executedAt.has_value()) {
-                            std::time_t execTime = std::chrono::system_clock::to_time_t(instr.executedAt.value());
-                            std::tm* local = std::localtime(&execTime);
-                            timestamp << "(" << std::put_time(local, "%m/%d/%Y %I:%M:%S %p") << ")";
-                        } else {
-                            timestamp << "(Time N/A)";
-                        }
-
-                        printLine(timestamp.str() + " Core:" + std::to_string(smiProcess->coreId) + " " + instr.msg);
+                        timestamp << "(" << std::put_time(std::localtime(&execTime), "%m/%d/%Y %I:%M:%S %p") << ")";
+                        printLine(timestamp.str() + " Core:" + std::to_string(record.coreId) + " " +
+                                  smiProcess->instructions[record.instruction].msg);
                     }
-                }
-                
-                printLine("");
+                    if (!note.empty()) {
+                        printLine(note);
+                    }
+
+                    printLine("");
 
-                //current instruction line & total lines of code
-                printLine("Current instruction line: " + std::to_string(smiProcess->currentInstruction));
-                printLine("Lines of code: " + std::to_string(smiProcess->instructions.size()));
+                    //current instruction line & total lines of code
+                    printLine("Current instruction line: " + std::to_string(smiProcess->currentLine()));
+                    printLine("Lines of code: " + std::to_string(smiProcess->lineCount));
+                    printLine("Nice: " + std::to_string(smiProcess->nice) +
+                              "  Virtual runtime: " + std::to_string(smiProcess->vruntime));
+                    printLine("Tickets: " + std::to_string(smiProcess->tickets) +
+                              "  Ticks run: " + std::to_string(smiProcess->ticksRun));
+                    if (smiProcess->deadlineMs > 0) {
+                        printLine("Deadline: " + std::to_string(smiProcess->deadlineMs) + " ms after creation");
+                    }
 
-                if (smiProcess->isFinished) {
-                    printLine("Finished!");
+                    if (smiProcess->finished()) {
+                        printLine("Finished!");
+                    }
                 }
                 
                 printLine("");
                 currentLine += printedLines + 2;
 
             } else {
-                std::cout << "\033[" << (currentLine + 1) << ";1H\033[2K";
+                moveToLine(currentLine + 1, true);
                 std::cout << "No scheduler process found for " << session.name << std::endl;
                 currentLine += 3;
             }
@@ -139,8 +213,8 @@ void screenSessionInterface(ScreenSession& session) {
         } else {
             // Print message below the prompt
             currentLine += 1;
-            std::cout << "\033[" << currentLine << ";1H\033[2K";
-            std::cout << "'" << input << "' command is not supported on the screen yet.";
+            moveToLine(currentLine, true);
+            std::cout << "'" << input << "' command is not supported on the screen yet.\n";
             std::cout.flush();
 
             // Move prompt line down for next input
@@ -149,6 +223,8 @@ void screenSessionInterface(ScreenSession& session) {
     }
 
     clearScreen();
+    std::cout.flush();
+    console.release();
 }
 
 void handleScreenCommand(const std::string& command) {
@@ -157,6 +233,33 @@ void handleScreenCommand(const std::string& command) {
     iss >> cmd >> flag >> name;
     
     if (flag == "-s") {
+            // Options follow the name, with at most one program file among them
+            std::string programFile, token;
+            int nice = 0;
+            int tickets = 0; // 0 = from the ticket rules
+            long long deadlineMs = 0;
+            bool validOptions = true;
+            while (iss >> token) {
+                if (token == "--nice") {
+                    validOptions = (bool)(iss >> nice) && nice >= CfsPolicy::kMinNice && nice <= CfsPolicy::kMaxNice;
+                } else if (token == "--tickets") {
+                    validOptions = (bool)(iss >> tickets) && tickets >= 1 && tickets <= kMaxTickets;
+                } else if (token == "--deadline") {
+                    validOptions = (bool)(iss >> deadlineMs) && deadlineMs >= 1;
+                } else if (programFile.empty() && token.rfind("--", 0) != 0) {
+                    programFile = token;
+                } else {
+                    validOptions = false;
+                }
+                if (!validOptions) break;
+            }
+            if (!validOptions) {
+                std::cout << "\nUsage: screen -s <name> [program-file] [--nice N] [--tickets T] [--deadline MS], with N from "
+                          << CfsPolicy::kMinNice << " to " << CfsPolicy::kMaxNice << ", T from 1 to " << kMaxTickets
+                          << " and MS at least 1\n";
+                return;
+            }
+
             // Check if the process already exists in the scheduler
             if (globalScheduler.getProcess(name)) {
                 std::cout << "\nProcess '" << name << "' already exists. Cannot use 'screen -s' on existing processes.\n";
@@ -169,19 +272,34 @@ void handleScreenCommand(const std::string& command) {
                 return;
             }
 
-            // If process does not exist yet, create it and attach to a screen session
-            globalScheduler.addProcess(name);
-            Process* newProcess = globalScheduler.getProcess(name);
+            // If process does not exist yet, create it and attach to a screen session.
+            // With a program file the process runs that program instead of a random one.
+            auto process = std::make_unique<Process>(name, -1);
+            if (programFile.empty()) {
+                process->generateRandomInstructions(systemConfig.minInstructions, systemConfig.maxInstructions);
+            } else {
+                std::string error;
+                if (!process->loadProgram(programFile, error)) {
+                    std::cout << "\nFailed to load program: " << error << "\n";
+                    return;
+                }
+            }
+            process->nice = nice;
+            process->tickets = tickets;
+            process->deadlineMs = deadlineMs;
+            globalScheduler.addProcess(std::move(process));
+            Process* newProcess = globalScheduler.pinProcess(name);
 
             if (newProcess) {
                 ScreenSession newSession = {
                     name,
-                    newProcess->currentInstruction,
-                    (int)newProcess->instructions.size(),
+                    newProcess->currentLine(),
+                    newProcess->lineCount,
                     getCurrentTimestamp()
                 };
                 screens[name] = newSession;
                 screenSessionInterface(screens[name]);
+                globalScheduler.unpinProcess(newProcess);
             } else {
                 std::cout << "\nFailed to create process in scheduler.\n";
             }
@@ -189,24 +307,26 @@ void handleScreenCommand(const std::string& command) {
         if (!screens.count(name) && !globalScheduler.getProcess(name)) {
             std::cout << "\nNo session named '" << name << "' found.\n";
         } else {
+            // Keep the process in memory (paging it in if it was swapped out) while it is on screen
+            Process* schedulerProcess = globalScheduler.pinProcess(name);
             if (!screens.count(name)) {
                 // Create session for scheduler process
-                Process* schedulerProcess = globalScheduler.getProcess(name);
                 ScreenSession newSession = {
                     name,
-                    schedulerProcess->currentInstruction,
-                    (int)schedulerProcess->instructions.size(),
+                    schedulerProcess->currentLine(),
+                    schedulerProcess->lineCount,
                     getCurrentTimestamp()
                 };
                 screens[name] = newSession;
             }
             screenSessionInterface(screens[name]);
+            globalScheduler.unpinProcess(schedulerProcess);
         }
     } else if (flag == "-ls") {
         // Show process list from scheduler
         std::cout << "\n";
         globalScheduler.printScreen();
     } else {
-        std::cout << "\nInvalid screen usage. Try: screen -s <name>, screen -r <name>, or screen -ls\n";
+        std::cout << "\nInvalid screen usage. Try: screen -s <name> [program-file] [--nice N] [--tickets T] [--deadline MS], screen -r <name>, or screen -ls\n";
     }
 }
\ No newline at end of file
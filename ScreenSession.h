@@ -9,6 +9,8 @@ struct ScreenSession {
     int currentLine;
     int totalLines;
     std::string timestamp;
+    size_t logCursor = 0; // process-smi: first PRINT log entry not shown yet
+    size_t logPage = 0;   // process-smi --page: last page shown, 1-based (0 = none)
 };
 
 // Function declarations
@@ -0,0 +1,110 @@
+#ifndef SERIALIZE_H
+#define SERIALIZE_H
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+// Little helpers for the binary checkpoint format. Values are written as fixed-width
+// host-order integers (the header records the byte order) and strings are interned
+// into a table so repeated PRINT messages and variable names are stored once.
+
+class BinaryWriter {
+public:
+    template <typename T>
+    void write(T value) {
+        static_assert(std::is_arithmetic<T>::value, "BinaryWriter::write takes plain numbers");
+        char bytes[sizeof(T)];
+        std::memcpy(bytes, &value, sizeof(T));
+        body.append(bytes, sizeof(T));
+    }
+
+    // Strings are written as an index into the string table
+    void writeString(const std::string& str) {
+        auto it = stringIndex.find(str);
+        if (it == stringIndex.end()) {
+            it = stringIndex.emplace(str, (uint32_t)strings.size()).first;
+            strings.push_back(str);
+        }
+        write<uint32_t>(it->second);
+    }
+
+    // Writes the string table followed by the body
+    std::string finish() const {
+        BinaryWriter table;
+        table.write<uint32_t>((uint32_t)strings.size());
+        for (const auto& str : strings) {
+            table.write<uint32_t>((uint32_t)str.size());
+            table.body.append(str);
+        }
+        return table.body + body;
+    }
+
+    std::string body;
+
+private:
+    std::vector<std::string> strings;
+    std::unordered_map<std::string, uint32_t> stringIndex;
+};
+
+class BinaryReader {
+public:
+    BinaryReader(const char* data, size_t size) : data(data), size(size), pos(0), ok(true) {}
+
+    template <typename T>
+    T read() {
+        static_assert(std::is_arithmetic<T>::value, "BinaryReader::read returns plain numbers");
+        T value{};
+        if (pos + sizeof(T) > size) {
+            ok = false;
+            return value;
+        }
+        std::memcpy(&value, data + pos, sizeof(T));
+        pos += sizeof(T);
+        return value;
+    }
+
+    const std::string& readString() {
+        static const std::string empty;
+        uint32_t index = read<uint32_t>();
+        if (index >= strings.size()) {
+            ok = false;
+            return empty;
+        }
+        return strings[index];
+    }
+
+    // Loads the string table written by BinaryWriter::finish()
+    bool readStringTable() {
+        uint32_t count = read<uint32_t>();
+        if (!ok || count > size - pos) {
+            ok = false;
+            return false;
+        }
+        strings.reserve(count);
+        for (uint32_t i = 0; i < count && ok; i++) {
+            uint32_t length = read<uint32_t>();
+            if (!ok || pos + length > size) {
+                ok = false;
+                break;
+            }
+            strings.emplace_back(data + pos, length);
+            pos += length;
+        }
+        return ok;
+    }
+
+    bool good() const { return ok; }
+
+private:
+    const char* data;
+    size_t size;
+    size_t pos;
+    bool ok;
+    std::vector<std::string> strings;
+};
+
+#endif
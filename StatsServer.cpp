@@ -0,0 +1,351 @@
+#include "StatsServer.h"
+#include <sstream>
+#include <iomanip>
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+#include <chrono>
+#include <algorithm>
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+std::string jsonString(const std::string& text) {
+    std::string out = "\"";
+    for (char c : text) {
+        switch (c) {
+            case '"': out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n"; break;
+            case '\t': out += "\\t"; break;
+            default:
+                if ((unsigned char)c < 0x20) {
+                    char escaped[8];
+                    std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+                    out += escaped;
+                } else {
+                    out += c;
+                }
+        }
+    }
+    return out + "\"";
+}
+
+// Prometheus label values escape backslash, double quote and newline
+std::string labelValue(const std::string& text) {
+    std::string out;
+    for (char c : text) {
+        if (c == '\\' || c == '"') out += '\\';
+        if (c == '\n') {
+            out += "\\n";
+            continue;
+        }
+        out += c;
+    }
+    return out;
+}
+
+// How long a connected client has to send its request line, and then to take the reply
+const int kRequestTimeoutMs = 1000;
+const int kResponseTimeoutMs = 2000;
+// How often the serve loop checks whether it should stop
+const int kStopPollMs = 200;
+// Connections served at once; more wait in the listen backlog
+const size_t kMaxClients = 32;
+
+}
+
+std::string formatJson(const StatsSnapshot& stats) {
+    std::ostringstream out;
+    out << "{\"timestamp_ms\":" << stats.timestampMs
+        << ",\"running\":" << (stats.running ? "true" : "false")
+        << ",\"scheduler\":" << jsonString(stats.scheduler)
+        << ",\"quantum_cycles\":" << stats.quantumCycles
+        << ",\"cpu_ticks\":" << stats.cpuTicks
+        << ",\"cpu_utilization\":" << std::fixed << std::setprecision(2) << stats.utilization
+        << ",\"cores_used\":" << stats.coresUsed
+        << ",\"cores_total\":" << stats.cores.size()
+        << ",\"context_switches\":" << stats.contextSwitches
+        << ",\"context_switch_cycles\":" << stats.switchCycles
+        << ",\"migrations\":" << stats.migrations
+        << ",\"warmup_cycles\":" << stats.warmupCycles
+        << ",\"instructions_retired\":" << stats.retiredInstructions
+        << ",\"memory\":{\"total_bytes\":" << stats.memoryTotal << ",\"used_bytes\":" << stats.memoryUsed << "}";
+
+    out << ",\"cores\":[";
+    for (size_t i = 0; i < stats.cores.size(); i++) {
+        const CoreSnapshot& core = stats.cores[i];
+        out << (i ? "," : "") << "{\"id\":" << core.id << ",\"domain\":" << core.domain
+            << ",\"draining\":" << (core.draining ? "true" : "false") << ",\"pid\":";
+        if (core.pid >= 0) out << core.pid; else out << "null";
+        out << ",\"quantum\":" << core.quantum << "}";
+    }
+    out << "],\"domains\":[";
+    for (size_t i = 0; i < stats.domains.size(); i++) {
+        const DomainSnapshot& domain = stats.domains[i];
+        out << (i ? "," : "") << "{\"id\":" << domain.id << ",\"cores\":" << domain.cores
+            << ",\"busy_cores\":" << domain.busyCores << ",\"ready_queue\":" << domain.readyQueue
+            << ",\"balanced_in\":" << domain.balancedIn << ",\"balanced_out\":" << domain.balancedOut << "}";
+    }
+    out << "],\"process_counts\":{\"ready\":" << stats.processesReady << ",\"running\":" << stats.processesRunning
+        << ",\"finished\":" << stats.processesFinished << ",\"swapped\":" << stats.processesSwapped << "}";
+    out << ",\"processes\":[";
+    for (size_t i = 0; i < stats.processes.size(); i++) {
+        const ProcessSnapshot& process = stats.processes[i];
+        out << (i ? "," : "") << "{\"pid\":" << process.pid << ",\"name\":" << jsonString(process.name)
+            << ",\"state\":\"" << process.state << "\",\"swapped\":" << (process.swapped ? "true" : "false")
+            << ",\"core\":" << process.core << ",\"line\":" << process.line << ",\"lines\":" << process.lines << "}";
+    }
+    out << "]}\n";
+    return out.str();
+}
+
+std::string formatPrometheus(const StatsSnapshot& stats) {
+    std::ostringstream out;
+    auto metric = [&](const char* name, const char* type, const char* help) {
+        out << "# HELP " << name << " " << help << "\n# TYPE " << name << " " << type << "\n";
+    };
+
+    metric("opesy_running", "gauge", "1 while the scheduler is running.");
+    out << "opesy_running " << (stats.running ? 1 : 0) << "\n";
+    metric("opesy_quantum_cycles", "gauge", "Round-robin time slice in ticks.");
+    out << "opesy_quantum_cycles " << stats.quantumCycles << "\n";
+    metric("opesy_cpu_ticks_total", "counter", "Scheduler ticks.");
+    out << "opesy_cpu_ticks_total " << stats.cpuTicks << "\n";
+    metric("opesy_cpu_utilization_percent", "gauge", "Share of cores running a process.");
+    out << "opesy_cpu_utilization_percent " << std::fixed << std::setprecision(2) << stats.utilization << "\n";
+    metric("opesy_cores", "gauge", "Cores by state.");
+    out << "opesy_cores{state=\"busy\"} " << stats.coresUsed << "\n";
+    out << "opesy_cores{state=\"idle\"} " << (long long)stats.cores.size() - stats.coresUsed << "\n";
+    metric("opesy_context_switches_total", "counter", "Dispatches onto a core.");
+    out << "opesy_context_switches_total " << stats.contextSwitches << "\n";
+    metric("opesy_context_switch_cycles_total", "counter", "Cycles spent on context-switch overhead.");
+    out << "opesy_context_switch_cycles_total " << stats.switchCycles << "\n";
+    metric("opesy_migrations_total", "counter", "Dispatches onto a different core than last time.");
+    out << "opesy_migrations_total " << stats.migrations << "\n";
+    metric("opesy_warmup_cycles_total", "counter", "Cycles spent warming up after a migration.");
+    out << "opesy_warmup_cycles_total " << stats.warmupCycles << "\n";
+    metric("opesy_instructions_retired_total", "counter", "Instructions retired.");
+    out << "opesy_instructions_retired_total " << stats.retiredInstructions << "\n";
+    metric("opesy_memory_bytes", "gauge", "Simulated physical memory.");
+    out << "opesy_memory_bytes{state=\"used\"} " << stats.memoryUsed << "\n";
+    out << "opesy_memory_bytes{state=\"free\"} " << stats.memoryTotal - stats.memoryUsed << "\n";
+
+    metric("opesy_core_busy", "gauge", "1 if the core has a process.");
+    for (const CoreSnapshot& core : stats.cores) {
+        out << "opesy_core_busy{core=\"" << core.id << "\",domain=\"" << core.domain << "\"} " << (core.pid >= 0 ? 1 : 0) << "\n";
+    }
+    metric("opesy_core_quantum", "gauge", "Ticks the core's process has had of its slice.");
+    for (const CoreSnapshot& core : stats.cores) {
+        out << "opesy_core_quantum{core=\"" << core.id << "\",domain=\"" << core.domain << "\"} " << core.quantum << "\n";
+    }
+    metric("opesy_ready_queue_length", "gauge", "Processes waiting in the domain's ready queue.");
+    for (const DomainSnapshot& domain : stats.domains) {
+        out << "opesy_ready_queue_length{domain=\"" << domain.id << "\"} " << domain.readyQueue << "\n";
+    }
+    metric("opesy_balanced_total", "counter", "Ready processes the balancer moved, by direction.");
+    for (const DomainSnapshot& domain : stats.domains) {
+        out << "opesy_balanced_total{domain=\"" << domain.id << "\",direction=\"in\"} " << domain.balancedIn << "\n";
+        out << "opesy_balanced_total{domain=\"" << domain.id << "\",direction=\"out\"} " << domain.balancedOut << "\n";
+    }
+
+    metric("opesy_processes", "gauge", "Processes by state.");
+    out << "opesy_processes{state=\"ready\"} " << stats.processesReady << "\n";
+    out << "opesy_processes{state=\"running\"} " << stats.processesRunning << "\n";
+    out << "opesy_processes{state=\"finished\"} " << stats.processesFinished << "\n";
+    metric("opesy_swapped_processes", "gauge", "Processes whose image is in the swap file.");
+    out << "opesy_swapped_processes " << stats.processesSwapped << "\n";
+    metric("opesy_process_line", "gauge", "Source line each process has reached (-1 while swapped out).");
+    for (const ProcessSnapshot& process : stats.processes) {
+        out << "opesy_process_line{pid=\"" << process.pid << "\",name=\"" << labelValue(process.name)
+            << "\",state=\"" << process.state << "\"} " << process.line << "\n";
+    }
+    metric("opesy_process_lines", "gauge", "Source program length of each process.");
+    for (const ProcessSnapshot& process : stats.processes) {
+        out << "opesy_process_lines{pid=\"" << process.pid << "\",name=\"" << labelValue(process.name) << "\"} "
+            << process.lines << "\n";
+    }
+    return out.str();
+}
+
+StatsServer::~StatsServer() {
+    stop();
+}
+
+void StatsServer::publish(std::shared_ptr<const StatsSnapshot> snapshot) {
+    std::atomic_store(&current, std::move(snapshot));
+}
+
+// The reply to one request line, with an HTTP header if it was an HTTP request
+std::string StatsServer::respond(const std::string& requestText) const {
+    std::string request = requestText.substr(0, requestText.find_first_of("\r\n"));
+
+    bool http = request.compare(0, 4, "GET ") == 0;
+    bool prometheus;
+    if (http) {
+        std::string target = request.substr(4, request.find(' ', 4) - 4);
+        prometheus = target == "/metrics";
+    } else {
+        prometheus = request == "prometheus" || request == "metrics";
+    }
+
+    std::shared_ptr<const StatsSnapshot> snapshot = std::atomic_load(&current);
+    std::string body;
+    if (!snapshot) {
+        body = prometheus ? "" : "{}\n";
+    } else {
+        body = prometheus ? formatPrometheus(*snapshot) : formatJson(*snapshot);
+    }
+
+    std::string response;
+    if (http) {
+        response = "HTTP/1.0 200 OK\r\nContent-Type: ";
+        response += prometheus ? "text/plain; version=0.0.4" : "application/json";
+        response += "\r\nContent-Length: " + std::to_string(body.size()) + "\r\nConnection: close\r\n\r\n";
+    }
+    return response + body;
+}
+
+#ifdef _WIN32
+
+bool StatsServer::start(const std::string&) {
+    return false;
+}
+
+void StatsServer::stop() {}
+
+void StatsServer::serveLoop() {}
+
+#else
+
+bool StatsServer::start(const std::string& socketPath) {
+    stop();
+
+    sockaddr_un address;
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (socketPath.empty() || socketPath.size() >= sizeof(address.sun_path)) return false;
+    std::strcpy(address.sun_path, socketPath.c_str());
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) return false;
+    unlink(socketPath.c_str()); // left behind by a run that did not shut down cleanly
+    if (bind(fd, (sockaddr*)&address, sizeof(address)) < 0 || listen(fd, 16) < 0) {
+        close(fd);
+        return false;
+    }
+
+    path = socketPath;
+    listenFd = fd;
+    serving = true;
+    thread = std::thread(&StatsServer::serveLoop, this);
+    return true;
+}
+
+void StatsServer::stop() {
+    if (!thread.joinable()) return;
+    serving = false;
+    thread.join();
+    close(listenFd);
+    unlink(path.c_str());
+    listenFd = -1;
+}
+
+// Serves up to kMaxClients connections at once until stop(). Every socket is
+// non-blocking and polled together, so a client that is slow to send its request or to
+// read the reply only holds up itself, and only until its deadline.
+void StatsServer::serveLoop() {
+    struct Client {
+        int fd;
+        std::string request;
+        std::string response;
+        size_t sent = 0;
+        bool answering = false; // request read, response being written
+        std::chrono::steady_clock::time_point deadline;
+    };
+    std::vector<Client> clients;
+
+#ifdef MSG_NOSIGNAL
+    const int sendFlags = MSG_NOSIGNAL; // a client that hung up must not kill the emulator
+#else
+    const int sendFlags = 0;
+#endif
+
+    while (serving) {
+        auto now = std::chrono::steady_clock::now();
+        std::vector<pollfd> fds;
+        fds.push_back({listenFd, (short)(clients.size() < kMaxClients ? POLLIN : 0), 0});
+        int timeoutMs = kStopPollMs;
+        for (const Client& client : clients) {
+            fds.push_back({client.fd, (short)(client.answering ? POLLOUT : POLLIN), 0});
+            long long left = std::chrono::duration_cast<std::chrono::milliseconds>(client.deadline - now).count();
+            timeoutMs = (int)std::max(0LL, std::min<long long>(timeoutMs, left + 1));
+        }
+        if (poll(fds.data(), fds.size(), timeoutMs) < 0) continue;
+        now = std::chrono::steady_clock::now();
+
+        for (size_t i = 0; i < clients.size(); i++) {
+            Client& client = clients[i];
+            short events = fds[i + 1].revents;
+            bool done = false;
+            if (!client.answering) {
+                // Read what has arrived; a client that sends nothing gets JSON at its deadline
+                bool complete = now >= client.deadline;
+                if (events & (POLLIN | POLLHUP | POLLERR)) {
+                    char buffer[256];
+                    ssize_t n = read(client.fd, buffer, sizeof(buffer));
+                    if (n > 0) {
+                        client.request.append(buffer, (size_t)n);
+                    } else if (n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) {
+                        complete = true;
+                    }
+                }
+                if (complete || client.request.find('\n') != std::string::npos || client.request.size() >= 1024) {
+                    client.response = respond(client.request);
+                    client.answering = true;
+                    client.deadline = now + std::chrono::milliseconds(kResponseTimeoutMs);
+                    events |= POLLOUT; // most replies fit the socket buffer; try now
+                }
+            }
+            if (client.answering && (events & (POLLOUT | POLLHUP | POLLERR))) {
+                ssize_t n = send(client.fd, client.response.data() + client.sent,
+                                 client.response.size() - client.sent, sendFlags);
+                if (n > 0) {
+                    client.sent += (size_t)n;
+                } else if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+                    done = true;
+                }
+                done = done || client.sent == client.response.size();
+            }
+            if (done || (client.answering && now >= client.deadline)) {
+                close(client.fd);
+                client.fd = -1;
+            }
+        }
+        clients.erase(std::remove_if(clients.begin(), clients.end(), [](const Client& client) { return client.fd < 0; }),
+                      clients.end());
+
+        if (fds[0].revents & POLLIN) {
+            int fd = accept(listenFd, nullptr, nullptr);
+            if (fd >= 0) {
+                fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+                Client client;
+                client.fd = fd;
+                client.deadline = now + std::chrono::milliseconds(kRequestTimeoutMs);
+                clients.push_back(std::move(client));
+            }
+        }
+    }
+
+    for (const Client& client : clients) {
+        close(client.fd);
+    }
+}
+
+#endif
@@ -0,0 +1,97 @@
+#ifndef STATS_SERVER_H
+#define STATS_SERVER_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <atomic>
+
+struct CoreSnapshot {
+    int id;
+    int domain;
+    bool draining;
+    int pid;        // -1 when idle
+    int quantum;    // ticks the process has had of its current slice
+};
+
+struct DomainSnapshot {
+    int id;
+    int cores;
+    int busyCores;
+    long long readyQueue;
+    long long balancedIn;
+    long long balancedOut;
+};
+
+struct ProcessSnapshot {
+    int pid;
+    std::string name;
+    std::string state; // "ready" or "running"
+    bool swapped;
+    int core;          // last core it ran on, -1 if none yet
+    int line;          // source line reached; -1 while swapped out unfinished
+    int lines;
+};
+
+// Everything the stats socket reports, copied out of the scheduler at one tick
+struct StatsSnapshot {
+    long long timestampMs = 0; // Unix time the snapshot was taken
+    bool running = false;
+    std::string scheduler;
+    int quantumCycles = 0;
+    int cpuTicks = 0;
+    double utilization = 0.0;
+    int coresUsed = 0;
+    long long contextSwitches = 0;
+    long long switchCycles = 0;
+    long long migrations = 0;
+    long long warmupCycles = 0;
+    long long retiredInstructions = 0;
+    long long memoryTotal = 0;
+    long long memoryUsed = 0;
+    std::vector<CoreSnapshot> cores;
+    std::vector<DomainSnapshot> domains;
+    // Process totals by state; the list below covers only the running processes and
+    // the front of each ready queue, so its cost does not grow with the process table
+    long long processesReady = 0;
+    long long processesRunning = 0;
+    long long processesFinished = 0;
+    long long processesSwapped = 0;
+    std::vector<ProcessSnapshot> processes;
+};
+
+std::string formatJson(const StatsSnapshot& stats);
+std::string formatPrometheus(const StatsSnapshot& stats);
+
+// Serves the latest published snapshot on a Unix domain socket, one request per
+// connection. A request line of "prometheus" gets the Prometheus text format and
+// anything else (or nothing) JSON; an HTTP "GET /metrics" or "GET /" is answered the
+// same way with an HTTP header, so curl --unix-socket works too. Requests are served
+// from the snapshot alone: polling never touches a scheduler lock. Clients are served
+// concurrently on non-blocking sockets, so an idle one cannot stall the others.
+class StatsServer {
+public:
+    ~StatsServer();
+
+    // Listens on path, replacing any server already running. False if the socket
+    // cannot be created (or on Windows, which has no Unix sockets here).
+    bool start(const std::string& path);
+    void stop();
+    bool running() const { return serving; }
+    const std::string& socketPath() const { return path; }
+
+    void publish(std::shared_ptr<const StatsSnapshot> snapshot);
+
+private:
+    void serveLoop();
+    std::string respond(const std::string& request) const;
+
+    std::shared_ptr<const StatsSnapshot> current; // swapped with std::atomic_load/store
+    std::thread thread;
+    std::atomic<bool> serving{false};
+    std::string path;
+    int listenFd = -1;
+};
+
+#endif
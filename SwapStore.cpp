@@ -0,0 +1,112 @@
+#include "SwapStore.h"
+#include <cstdio>
+#include <algorithm>
+
+SwapStore::~SwapStore() {
+    close();
+}
+
+bool SwapStore::open(const std::string& filename) {
+    close();
+    file.open(filename, std::ios::in | std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) return false;
+    path = filename;
+    counters = SwapStats();
+    return true;
+}
+
+void SwapStore::close() {
+    if (file.is_open()) {
+        file.close();
+        std::remove(path.c_str());
+    }
+    fileEnd = 0;
+    holes.clear();
+    extents.clear();
+}
+
+long long SwapStore::store(const std::string& image) {
+    long long size = (long long)image.size();
+    long long offset = fileEnd;
+    auto hole = std::find_if(holes.begin(), holes.end(), [&](const std::pair<const long long, long long>& h) {
+        return h.second >= size;
+    });
+    if (hole != holes.end()) {
+        offset = hole->first;
+    }
+
+    file.clear();
+    file.seekp(offset);
+    file.write(image.data(), (std::streamsize)size);
+    if (!file) return -1;
+
+    if (hole != holes.end()) {
+        long long remaining = hole->second - size;
+        holes.erase(hole);
+        if (remaining > 0) holes[offset + size] = remaining;
+    } else {
+        fileEnd += size;
+    }
+    extents[offset] = size;
+    counters.images++;
+    counters.imageBytes += size;
+    return offset;
+}
+
+bool SwapStore::load(long long offset, std::string& image) {
+    auto extent = extents.find(offset);
+    if (extent == extents.end()) return false;
+
+    image.resize((size_t)extent->second);
+    file.clear();
+    file.seekg(offset);
+    file.read(&image[0], (std::streamsize)image.size());
+    return (bool)file;
+}
+
+void SwapStore::release(long long offset) {
+    auto extent = extents.find(offset);
+    if (extent == extents.end()) return;
+    long long size = extent->second;
+    extents.erase(extent);
+    counters.images--;
+    counters.imageBytes -= size;
+
+    // Merge with the holes on either side; a hole at the end just shortens the file
+    auto next = holes.lower_bound(offset);
+    if (next != holes.end() && offset + size == next->first) {
+        size += next->second;
+        next = holes.erase(next);
+    }
+    if (next != holes.begin()) {
+        auto prev = std::prev(next);
+        if (prev->first + prev->second == offset) {
+            offset = prev->first;
+            size += prev->second;
+            holes.erase(prev);
+        }
+    }
+    if (offset + size == fileEnd) {
+        fileEnd = offset;
+    } else {
+        holes[offset] = size;
+    }
+}
+
+void SwapStore::recordSwapOut(long long ns) {
+    counters.swapOuts++;
+    counters.swapOutNs += ns;
+    counters.maxSwapOutNs = std::max(counters.maxSwapOutNs, ns);
+}
+
+void SwapStore::recordSwapIn(long long ns) {
+    counters.swapIns++;
+    counters.swapInNs += ns;
+    counters.maxSwapInNs = std::max(counters.maxSwapInNs, ns);
+}
+
+SwapStats SwapStore::stats() const {
+    SwapStats stats = counters;
+    stats.fileBytes = fileEnd;
+    return stats;
+}
@@ -0,0 +1,55 @@
+#ifndef SWAP_STORE_H
+#define SWAP_STORE_H
+
+#include <string>
+#include <map>
+#include <fstream>
+#include <cstdint>
+
+struct SwapStats {
+    long long images = 0;     // process images currently in the file
+    long long imageBytes = 0;
+    long long fileBytes = 0;
+    long long swapOuts = 0;
+    long long swapIns = 0;
+    long long swapOutNs = 0;
+    long long swapInNs = 0;
+    long long maxSwapOutNs = 0;
+    long long maxSwapInNs = 0;
+};
+
+// A scratch file holding swapped-out process images. Each image is one contiguous
+// extent; freed extents are reused first-fit and merged with their neighbours, so the
+// file only grows when no hole is large enough. Not thread-safe: the scheduler
+// serialises all use behind its swap lock.
+class SwapStore {
+public:
+    ~SwapStore();
+
+    // Starts over with an empty file at path, replacing any earlier one
+    bool open(const std::string& path);
+    // Deletes the file
+    void close();
+    bool isOpen() const { return file.is_open(); }
+
+    // Writes image and returns its offset, or -1 on an I/O error
+    long long store(const std::string& image);
+    // Reads back the image stored at offset; the extent stays allocated
+    bool load(long long offset, std::string& image);
+    void release(long long offset);
+
+    void recordSwapOut(long long ns);
+    void recordSwapIn(long long ns);
+
+    SwapStats stats() const;
+
+private:
+    std::fstream file;
+    std::string path;
+    long long fileEnd = 0;
+    std::map<long long, long long> holes;  // offset -> size
+    std::map<long long, long long> extents; // offset -> size, in use
+    SwapStats counters;
+};
+
+#endif
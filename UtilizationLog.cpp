@@ -0,0 +1,147 @@
+#include "UtilizationLog.h"
+#include <sstream>
+#include <iomanip>
+#include <cstdio>
+#include <algorithm>
+
+bool UtilizationLog::open(const std::string& path, long long maxFileBytes, long long maxFileAgeMs) {
+    std::lock_guard<std::mutex> lock(mutex);
+    file.close();
+    logPath = path;
+    maxBytes = maxFileBytes;
+    maxAgeMs = maxFileAgeMs;
+    rotated.clear();
+    active = LogSegmentSummary();
+    lastRetired = -1;
+
+    std::ifstream index(logPath + ".index");
+    LogSegmentSummary summary;
+    while (index >> summary.seq >> summary.firstMs >> summary.lastMs >> summary.samples >> summary.utilizationSum
+                 >> summary.utilizationPeak >> summary.completions >> summary.turnaroundMsSum
+                 >> summary.retiredInstructions >> summary.bytes) {
+        rotated.push_back(summary);
+    }
+    active.seq = rotated.empty() ? 1 : rotated.back().seq + 1;
+    recoverActiveSegment();
+
+    file.open(logPath, std::ios::app);
+    return file.is_open();
+}
+
+void UtilizationLog::close() {
+    std::lock_guard<std::mutex> lock(mutex);
+    file.close();
+}
+
+bool UtilizationLog::isOpen() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return file.is_open();
+}
+
+std::string UtilizationLog::path() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return logPath;
+}
+
+// Rebuilds the active segment's summary from a file an earlier run was appending to.
+// Bounded by the rotation size. Caller holds mutex.
+void UtilizationLog::recoverActiveSegment() {
+    std::ifstream in(logPath);
+    std::string line;
+    while (std::getline(in, line)) {
+        active.bytes += (long long)line.size() + 1;
+        std::istringstream record(line);
+        char type;
+        long long timeMs;
+        if (!(record >> type >> timeMs)) continue;
+        if (active.firstMs == 0) active.firstMs = timeMs;
+        active.lastMs = timeMs;
+        if (type == 'U') {
+            int tick, busy, cores;
+            double utilization;
+            char slash;
+            long long ready, retired;
+            if (!(record >> tick >> utilization >> busy >> slash >> cores >> ready >> retired)) continue;
+            active.samples++;
+            active.utilizationSum += utilization;
+            active.utilizationPeak = std::max(active.utilizationPeak, utilization);
+            if (lastRetired >= 0 && retired >= lastRetired) active.retiredInstructions += retired - lastRetired;
+            lastRetired = retired;
+        } else if (type == 'F') {
+            int pid, lines;
+            std::string name;
+            long long turnaroundMs;
+            if (!(record >> pid >> name >> lines >> turnaroundMs)) continue;
+            active.completions++;
+            active.turnaroundMsSum += turnaroundMs;
+        }
+    }
+}
+
+void UtilizationLog::append(const UtilizationSample& sample, const std::vector<CompletionRecord>& completions) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!file.is_open()) return;
+
+    std::ostringstream records;
+    for (const CompletionRecord& completion : completions) {
+        records << "F " << completion.timeMs << " " << completion.pid << " " << completion.name << " "
+                << completion.lines << " " << completion.turnaroundMs << "\n";
+        active.completions++;
+        active.turnaroundMsSum += completion.turnaroundMs;
+    }
+    records << "U " << sample.timeMs << " " << sample.tick << " " << std::fixed << std::setprecision(1)
+            << sample.utilization << " " << sample.busyCores << "/" << sample.cores << " "
+            << sample.readyProcesses << " " << sample.retiredInstructions << " " << sample.contextSwitches << "\n";
+    std::string text = records.str();
+    file << text;
+    file.flush(); // readers tailing the log see every record as it is written
+
+    if (active.firstMs == 0) active.firstMs = completions.empty() ? sample.timeMs : completions.front().timeMs;
+    active.lastMs = sample.timeMs;
+    active.samples++;
+    active.utilizationSum += sample.utilization;
+    active.utilizationPeak = std::max(active.utilizationPeak, sample.utilization);
+    // A restore rewinds the counter; count nothing for that interval
+    if (lastRetired >= 0 && sample.retiredInstructions >= lastRetired) {
+        active.retiredInstructions += sample.retiredInstructions - lastRetired;
+    }
+    lastRetired = sample.retiredInstructions;
+    active.bytes += (long long)text.size();
+
+    if ((maxBytes > 0 && active.bytes >= maxBytes) || (maxAgeMs > 0 && active.lastMs - active.firstMs >= maxAgeMs)) {
+        rotate();
+    }
+}
+
+// Closes the active file as segment active.seq and starts an empty one. Caller holds mutex.
+void UtilizationLog::rotate() {
+    file.close();
+    std::string segmentPath = logPath + "." + std::to_string(active.seq);
+    std::rename(logPath.c_str(), segmentPath.c_str());
+    std::ofstream index(logPath + ".index", std::ios::app);
+    index << formatSummary(active);
+    rotated.push_back(active);
+
+    if (active.seq > kKeptSegments) {
+        std::remove((logPath + "." + std::to_string(active.seq - kKeptSegments)).c_str());
+    }
+    active = LogSegmentSummary();
+    active.seq = rotated.back().seq + 1;
+    file.open(logPath, std::ios::app);
+}
+
+std::string UtilizationLog::formatSummary(const LogSegmentSummary& summary) {
+    std::ostringstream out;
+    out << summary.seq << " " << summary.firstMs << " " << summary.lastMs << " " << summary.samples << " "
+        << std::fixed << std::setprecision(3) << summary.utilizationSum << " " << summary.utilizationPeak << " "
+        << summary.completions << " " << summary.turnaroundMsSum << " " << summary.retiredInstructions << " "
+        << summary.bytes << "\n";
+    return out.str();
+}
+
+std::vector<LogSegmentSummary> UtilizationLog::segments() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<LogSegmentSummary> all = rotated;
+    if (active.samples > 0 || active.completions > 0) all.push_back(active);
+    return all;
+}
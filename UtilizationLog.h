@@ -0,0 +1,82 @@
+#ifndef UTILIZATION_LOG_H
+#define UTILIZATION_LOG_H
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <mutex>
+
+// One periodic utilization sample
+struct UtilizationSample {
+    long long timeMs;         // Unix time
+    int tick;
+    double utilization;       // percent of cores busy
+    int busyCores;
+    int cores;
+    long long readyProcesses;
+    long long retiredInstructions; // cumulative
+    long long contextSwitches;     // cumulative
+};
+
+// A process that finished since the previous sample
+struct CompletionRecord {
+    long long timeMs; // Unix time it finished
+    int pid;
+    std::string name;
+    int lines;
+    long long turnaroundMs; // creation to finish
+};
+
+// What one log segment holds, as kept in the index
+struct LogSegmentSummary {
+    long long seq = 0;
+    long long firstMs = 0;
+    long long lastMs = 0;
+    long long samples = 0;
+    double utilizationSum = 0.0;
+    double utilizationPeak = 0.0;
+    long long completions = 0;
+    long long turnaroundMsSum = 0;
+    long long retiredInstructions = 0; // retired while the segment was written
+    long long bytes = 0;
+};
+
+// Append-only utilization log. Records go to path, one compact line each:
+//     U <ms> <tick> <util%> <busy>/<cores> <ready> <retired> <switches>
+//     F <ms> <pid> <name> <lines> <turnaround-ms>
+// Once the active file passes maxBytes or has covered maxAgeMs it is renamed to
+// path.<seq> and a summary line for it is appended to path.index, so a report over
+// the whole history reads the index rather than the records. Only the newest
+// kKeptSegments rotated files are kept; the index keeps every summary. Thread-safe.
+class UtilizationLog {
+public:
+    // Starts appending to path, picking up the index and active segment a previous
+    // run left there. False if the file cannot be opened.
+    bool open(const std::string& path, long long maxBytes, long long maxAgeMs);
+    void close();
+    bool isOpen() const;
+    std::string path() const;
+
+    void append(const UtilizationSample& sample, const std::vector<CompletionRecord>& completions);
+
+    // Summaries of the rotated segments, oldest first, then the active one
+    std::vector<LogSegmentSummary> segments() const;
+
+    static const int kKeptSegments = 8;
+
+private:
+    void rotate();
+    void recoverActiveSegment();
+    static std::string formatSummary(const LogSegmentSummary& summary);
+
+    mutable std::mutex mutex;
+    std::ofstream file;
+    std::string logPath;
+    long long maxBytes = 0;
+    long long maxAgeMs = 0;
+    std::vector<LogSegmentSummary> rotated;
+    LogSegmentSummary active;
+    long long lastRetired = -1; // cumulative count at the previous sample
+};
+
+#endif
@@ -3,12 +3,28 @@
 #include <ctime>
 #include <iomanip>
 #include <sstream>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
 #include "ScreenSession.h"
 #include "Config.h"
 #include "Scheduler.h"
+#include "Console.h"
 
 // Global variables
-bool isInitialized = false;
+std::atomic<bool> isInitialized(false); // set by the executor, read by the CLI thread
 
 void printHeader() {
     std::cout << R"(
@@ -21,15 +37,23 @@ void printHeader() {
     std::cout << "\033[32mHello, Welcome to CSOPESY commandline!\033[0m\n";
     std::cout << "\033[33mType 'exit' to quit, 'clear' to clear the screen\033[0m\n\n";
     std::cout << "\033[34mUse: 'initialize' to initialize the processor configuration\033[0m\n";
-    std::cout << "\033[34m     'screen -s <name>' to start a screen\033[0m\n";
+    std::cout << "\033[34m     'screen -s <name> [file] [--nice N] [--tickets T] [--deadline MS]' to start a screen\033[0m\n";
     std::cout << "\033[34m     'screen -r <name>' to resume a screen\033[0m\n";
     std::cout << "\033[34m     'screen -ls' to list all processes\033[0m\n";
     std::cout << "\033[34m     'scheduler-test' to start the scheduler\033[0m\n";
     std::cout << "\033[34m     'scheduler-stop' to stop the scheduler\033[0m\n";
     std::cout << "\033[34m     'report-util' to generate CPU utilization report\033[0m\n";
+    std::cout << "\033[34m     'reload-config' to apply config.txt to the running scheduler\033[0m\n";
+    std::cout << "\033[34m     'checkpoint <file>' to save the scheduler state\033[0m\n";
+    std::cout << "\033[34m     'restore <file>' to load a saved scheduler state\033[0m\n";
+    std::cout << "\033[34m     'replay <file> [speed]' to replay a workload trace\033[0m\n";
+    std::cout << "\033[34m     'lock-stats [reset]' to show scheduler lock wait and hold times\033[0m\n";
+    std::cout << "\033[34m     'vmstat' to show simulated memory, fragmentation and swap activity\033[0m\n";
+    std::cout << "\033[34m     'sleep <ms>' to pause before the next command\033[0m\n";
 }
 
 void clearScreen() {
+    if (console.headless()) return; // a transcript has no screen to clear
     std::system("cls");
     printHeader();
 }
@@ -43,7 +67,24 @@ void initialize() {
         std::cout << "- batchProcessFreq: " << systemConfig.batchProcessFreq << "\n";
         std::cout << "- minInstructions: " << systemConfig.minInstructions << "\n";
         std::cout << "- maxInstructions: " << systemConfig.maxInstructions << "\n";
-        std::cout << "- delayPerExec: " << systemConfig.delayPerExec << "\n\n";
+        std::cout << "- delayPerExec: " << systemConfig.delayPerExec << "\n";
+        std::cout << "- instructionsPerTick: " << systemConfig.instructionsPerTick << "\n";
+        std::cout << "- optimizePrograms: " << systemConfig.optimizePrograms << "\n";
+        std::cout << "- cacheAffinity: " << systemConfig.cacheAffinity << "\n";
+        std::cout << "- migrationCost: " << systemConfig.migrationCost << "\n";
+        std::cout << "- contextSwitchCycles: " << systemConfig.contextSwitchCycles << "\n";
+        std::cout << "- quantumAutotune: " << systemConfig.quantumAutotune << "\n";
+        std::cout << "- maxOverallMem: " << systemConfig.maxOverallMem << "\n";
+        std::cout << "- memPerProc: " << systemConfig.minMemPerProc << " - " << systemConfig.maxMemPerProc << "\n";
+        std::cout << "- memAllocator: " << systemConfig.memAllocator << "\n";
+        std::cout << "- swapThresholdMs: " << systemConfig.swapThresholdMs << "\n";
+        std::cout << "- swapFile: " << systemConfig.swapFile << "\n";
+        std::cout << "- domains: " << systemConfig.domains << "\n";
+        std::cout << "- statsSocket: " << systemConfig.statsSocket << "\n";
+        std::cout << "- logIntervalMs: " << systemConfig.logIntervalMs << "\n";
+        std::cout << "- logFile: " << systemConfig.logFile << "\n";
+        std::cout << "- logRotation: " << systemConfig.logMaxBytes << " bytes / " << systemConfig.logMaxAgeS << " s\n";
+        std::cout << "- tickets: " << systemConfig.tickets << "\n\n";
         
         // Initialize the scheduler
         if (globalScheduler.initialize()) {
@@ -56,6 +97,20 @@ void initialize() {
     }
 }
 
+void reloadConfig() {
+    // Start from the current settings so keys missing from the file are left unchanged
+    Config newConfig = systemConfig;
+    if (!loadConfig("config.txt", newConfig)) {
+        std::cout << "Failed to load configuration.\n";
+        return;
+    }
+    if (newConfig.numCPU < 1) {
+        std::cout << "num-cpu must be at least 1.\n";
+        return;
+    }
+    globalScheduler.reloadConfig(newConfig);
+}
+
 void schedulerTest() {
     if (!isInitialized) {
         std::cout << "Please run 'initialize' command first.\n";
@@ -80,51 +135,248 @@ void reportUtil() {
     globalScheduler.reportUtil();
 }
 
-int main() {
+void replay(const std::string& command) {
+    std::istringstream iss(command);
+    std::string cmd, filename;
+    double speed = 0;
+    iss >> cmd >> filename;
+    if (filename.empty()) {
+        std::cout << "Usage: replay <file> [speed]\n";
+        return;
+    }
+    if (!(iss >> speed)) {
+        speed = 0;
+    }
+    globalScheduler.replay(filename, speed);
+}
+
+// Commands typed at the prompt are queued for the executor thread, so a slow command
+// such as report-util never holds up the prompt. Commands that need the terminal
+// (screen -s/-r, clear) stay on the CLI thread and first wait for the queue to drain,
+// so everything still runs in the order it was typed.
+class CommandQueue {
+public:
+    void push(const std::string& command) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            commands.push_back(command);
+        }
+        cv.notify_all();
+    }
+
+    // Blocks for the next command; false once the queue is closed and empty
+    bool pop(std::string& command) {
+        std::unique_lock<std::mutex> lock(mutex);
+        cv.wait(lock, [this] { return !commands.empty() || closed; });
+        if (commands.empty()) return false;
+        command = commands.front();
+        commands.pop_front();
+        busy = true;
+        return true;
+    }
+
+    void done() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            busy = false;
+        }
+        cv.notify_all();
+    }
+
+    void waitIdle() {
+        std::unique_lock<std::mutex> lock(mutex);
+        cv.wait(lock, [this] { return commands.empty() && !busy; });
+    }
+
+    void close() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            closed = true;
+        }
+        cv.notify_all();
+    }
+
+private:
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::deque<std::string> commands;
+    bool busy = false;
+    bool closed = false;
+};
+
+CommandQueue commandQueue;
+
+void executeCommand(const std::string& userInput) {
+    if (userInput.rfind("sleep ", 0) == 0) {
+        // Lets scripts wait for the scheduler; later commands stay queued meanwhile
+        int ms = std::atoi(userInput.c_str() + 6);
+        std::this_thread::sleep_for(std::chrono::milliseconds(std::max(0, ms)));
+    }
+    else if (userInput == "initialize") {
+        std::cout << "\n";
+        initialize();
+    }
+    else if (!isInitialized) {
+        std::cout << "\n";
+        std::cout << "Please run 'initialize' command first.\n";
+    }
+    else if (userInput == "scheduler-test") {
+        std::cout << "\n";
+        schedulerTest();
+    }
+    else if (userInput == "scheduler-stop") {
+        std::cout << "\n";
+        schedulerStop();
+    }
+    else if (userInput == "report-util") {
+        std::cout << "\n";
+        reportUtil();
+    }
+    else if (userInput == "reload-config") {
+        std::cout << "\n";
+        reloadConfig();
+    }
+    else if (userInput.rfind("checkpoint ", 0) == 0) {
+        std::cout << "\n";
+        globalScheduler.checkpoint(userInput.substr(11));
+    }
+    else if (userInput.rfind("restore ", 0) == 0) {
+        std::cout << "\n";
+        globalScheduler.restore(userInput.substr(8));
+    }
+    else if (userInput == "vmstat") {
+        std::cout << "\n";
+        globalScheduler.vmstat();
+    }
+    else if (userInput == "lock-stats" || userInput == "lock-stats reset") {
+        std::cout << "\n";
+        globalScheduler.lockStats(userInput == "lock-stats reset");
+    }
+    else if (userInput.rfind("replay ", 0) == 0) {
+        std::cout << "\n";
+        replay(userInput);
+    }
+    else if (userInput.rfind("screen", 0) == 0) {
+        handleScreenCommand(userInput);
+    }
+    else {
+        std::cout << "\n";
+        std::cout << "Unknown command. Please try again\n";
+    }
+}
+
+// Headless transcripts show each command as it starts and how long it took
+void echoCommand(const std::string& command) {
+    if (console.headless()) {
+        std::cout << "\n> " << command << "\n";
+    }
+}
+
+void executorLoop() {
+    std::string command;
+    while (commandQueue.pop(command)) {
+        auto start = std::chrono::steady_clock::now();
+        echoCommand(command);
+        executeCommand(command);
+        if (console.headless()) {
+            double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            std::cout << "[" << command << ": " << std::fixed << std::setprecision(3) << ms << " ms]\n"
+                      << std::defaultfloat << std::setprecision(6);
+        }
+        std::cout.flush(); // the command's output reaches the terminal as one block
+        commandQueue.done();
+    }
+}
+
+bool stdinIsTerminal() {
+#ifdef _WIN32
+    return _isatty(_fileno(stdin)) != 0;
+#else
+    return isatty(fileno(stdin)) != 0;
+#endif
+}
+
+// opesy [--script <file>]
+// With a script, or with stdin redirected from a file or pipe, commands are read in
+// order and run headless: no banner, prompt or ANSI screen control, '#' comments and
+// blank lines skipped, and every command echoed with its run time.
+int main(int argc, char* argv[]) {
+    std::ifstream script;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--script" && i + 1 < argc) {
+            script.open(argv[++i]);
+            if (!script.is_open()) {
+                std::cerr << "Failed to open script " << argv[i] << "\n";
+                return 1;
+            }
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [--script <file>]\n";
+            return 1;
+        }
+    }
+
+    console.install();
+    if (script.is_open()) {
+        console.setInput(script);
+        console.setHeadless(true);
+    } else if (!stdinIsTerminal()) {
+        console.setHeadless(true);
+    }
+
     std::string userInput;
-    printHeader();
+    if (!console.headless()) {
+        printHeader();
+    }
+    std::cout.flush();
+    auto sessionStart = std::chrono::steady_clock::now();
 
-    while (true) {
-        std::cout << "\n>";
-        std::getline(std::cin, userInput);
+    std::thread executor(executorLoop);
 
-        if (userInput == "initialize") {
-            std::cout << "\n";
-            initialize();
+    while (true) {
+        console.showPrompt();
+        if (!std::getline(console.input(), userInput)) {
+            userInput = "exit"; // end of input
         }
-        else if (userInput == "clear") {
-            clearScreen();
+        console.promptAnswered();
+        if (console.headless() && (userInput.empty() || userInput[0] == '#')) {
+            continue;
         }
-        else if (userInput == "exit") {
+
+        if (userInput == "exit") {
+            commandQueue.waitIdle();
+            echoCommand(userInput);
             if (isInitialized) {
                 globalScheduler.schedulerStop();
             }
             break;
         }
-        else if (!isInitialized) {
-            std::cout << "\n";
-            std::cout << "Please run 'initialize' command first.\n";
-        }
-        else if (userInput == "scheduler-test") {
-            std::cout << "\n";
-            schedulerTest();
-        }
-        else if (userInput == "scheduler-stop") {
-            std::cout << "\n";
-            schedulerStop();
-        }
-        else if (userInput == "report-util") {
-            std::cout << "\n";
-            reportUtil();
+        else if (userInput == "clear") {
+            commandQueue.waitIdle();
+            clearScreen();
         }
-        else if (userInput.rfind("screen", 0) == 0) {
-            handleScreenCommand(userInput);
+        else if (userInput.rfind("screen -s", 0) == 0 || userInput.rfind("screen -r", 0) == 0) {
+            commandQueue.waitIdle();
+            echoCommand(userInput);
+            if (isInitialized) {
+                handleScreenCommand(userInput);
+            } else {
+                std::cout << "\n";
+                std::cout << "Please run 'initialize' command first.\n";
+            }
         }
-        else {
-            std::cout << "\n";
-            std::cout << "Unknown command. Please try again\n";
+        else if (!userInput.empty()) {
+            commandQueue.push(userInput);
         }
+        std::cout.flush();
     }
 
+    commandQueue.close();
+    executor.join();
+    if (console.headless()) {
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - sessionStart).count();
+        std::cout << "\nSession finished in " << seconds << "s\n";
+    }
+    std::cout.flush();
     return 0;
-}
\ No newline at end of file
+}